@@ -0,0 +1,203 @@
+// File: Benchmark.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Times each stage of the sliding window algorithm on a VCF file.
+
+#include "../src/SlidingWindow.h"
+
+#include <string.h>
+
+#include <time.h>
+
+#include <unistd.h>
+
+#include <sys/resource.h>
+
+#include <sys/wait.h>
+
+// The arguments and results shared by every stage.
+typedef struct {
+    char* file_name;
+    int numThreads;
+    // The samples to parse. If NULL, all samples are parsed.
+    char* samples;
+    int WINDOW_SIZE;
+    int HAP_SIZE;
+    int OFFSET_SIZE;
+    // The number of loci the stage processed. If 0, the stage has no per-locus rate.
+    long numLoci;
+    // The number of times the stage called the timed function.
+    long numCalls;
+    // The number of samples in the file.
+    int numSamples;
+    // The seconds spent in the timed function.
+    double seconds;
+} Benchmark;
+
+// Returns the current time in seconds.
+static double now() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Opens the file the way the driver does.
+static VCFGenotypeParser* open_parser(Benchmark* bench) {
+    VCFGenotypeParser* parser = init_vcf_genotype_parser_with_samples(bench -> file_name, bench -> numThreads, bench -> samples);
+    if (parser == NULL) {
+        fprintf(stderr, "Could not open %s.\n", bench -> file_name);
+        exit(1);
+    }
+    enable_genotype_packing(parser);
+    enable_locus_pipelining(parser);
+    bench -> numSamples = parser -> num_samples;
+    return parser;
+}
+
+// Times reading every locus in the file.
+static void bench_get_next_locus(Benchmark* bench) {
+    VCFGenotypeParser* parser = open_parser(bench);
+    kstring_t* chromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
+    GENOTYPE* genotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    int position, numAlleles;
+    double start = now();
+    while (!parser -> isEOF) {
+        get_next_locus(parser, chromosome, &position, &numAlleles, &genotypes);
+        bench -> numLoci++;
+        bench -> numCalls++;
+    }
+    bench -> seconds = now() - start;
+    free(ks_str(chromosome)); free(chromosome);
+    free(genotypes);
+    destroy_vcf_genotype_parser(parser);
+}
+
+// Times encoding every haplotype in the file. Includes reading the loci.
+static void bench_get_next_haplotype(Benchmark* bench) {
+    VCFGenotypeParser* parser = open_parser(bench);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+    double start = now();
+    while (!parser -> isEOF) {
+        get_next_haplotype(parser, encoder, true, bench -> HAP_SIZE);
+        bench -> numLoci += encoder -> numLoci;
+        bench -> numCalls++;
+    }
+    bench -> seconds = now() - start;
+    destroy_vcf_genotype_parser(parser);
+    destroy_haplotype_encoder(encoder);
+}
+
+// Times every relabel of the tree, in the middle and at the end of a haplotype. Reading and
+//  encoding are not timed. add_locus relabels once the tree reaches MAX_NUM_LEAVES, so the
+//  tree is relabeled here just before the locus that would, and add_locus never relabels.
+//  Only the relabels are timed, so there is no per-locus rate.
+static void bench_relabel_haplotypes(Benchmark* bench) {
+    VCFGenotypeParser* parser = open_parser(bench);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+    GENOTYPE* genotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    int position, numAlleles;
+    while (!parser -> isEOF) {
+        start_haplotype(parser, encoder);
+        bool isSameChromosome = true;
+        while (!(parser -> isEOF) && encoder -> numLoci < bench -> HAP_SIZE && isSameChromosome) {
+            get_next_locus(parser, NULL, &position, &numAlleles, &genotypes);
+            if ((long) encoder -> numLeaves * (numAlleles + 1) >= MAX_NUM_LEAVES) {
+                double start = now();
+                relabel_haplotypes(encoder);
+                bench -> seconds += now() - start;
+                bench -> numCalls++;
+            }
+            add_shared_locus(parser, encoder, genotypes, position, numAlleles, true);
+            isSameChromosome = parser -> contigId == parser -> nextContigId;
+        }
+        double start = now();
+        finish_haplotype(parser, encoder);
+        bench -> seconds += now() - start;
+        bench -> numCalls++;
+    }
+    free(genotypes);
+    destroy_vcf_genotype_parser(parser);
+    destroy_haplotype_encoder(encoder);
+}
+
+// Counts the loci in the file without timing them.
+static long count_loci(Benchmark* bench) {
+    Benchmark counter = *bench;
+    counter.numLoci = 0;
+    bench_get_next_locus(&counter);
+    return counter.numLoci;
+}
+
+// Times sliding through the whole genome. Includes reading, encoding, and relabeling.
+//  Windows overlap, so the loci are counted in a separate pass.
+static void bench_slide_through_genome(Benchmark* bench) {
+    bench -> numLoci = count_loci(bench);
+    VCFGenotypeParser* parser = open_parser(bench);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+    double start = now();
+    klist_t(WindowPtr)* windows = slide_through_genome(parser, encoder, bench -> WINDOW_SIZE, bench -> HAP_SIZE, bench -> OFFSET_SIZE);
+    bench -> seconds = now() - start;
+    bench -> numCalls = 1;
+    kl_destroy(WindowPtr, windows);
+    destroy_vcf_genotype_parser(parser);
+    destroy_haplotype_encoder(encoder);
+}
+
+// Runs a stage in a child process, so the peak RSS reported is the stage's alone.
+// Accepts:
+//  char* name -> The name of the stage.
+//  void (*stage)(Benchmark*) -> The stage to run.
+//  Benchmark* bench -> The arguments of the stage.
+// Returns:
+//  int, 0 if the stage succeeded.
+static int run_stage(char* name, void (*stage)(Benchmark*), Benchmark* bench) {
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        stage(bench);
+        printf("%-22s %10.3f %12ld", name, bench -> seconds, bench -> numCalls);
+        if (bench -> numLoci > 0)
+            printf(" %14.0f %16.0f", bench -> numLoci / bench -> seconds, (double) bench -> numLoci * bench -> numSamples / bench -> seconds);
+        else
+            printf(" %14s %16s", "-", "-");
+        fflush(stdout);
+        _exit(0);
+    }
+    int status;
+    struct rusage usage;
+    if (pid < 0 || wait4(pid, &status, 0, &usage) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "\n%s failed.\n", name);
+        return 1;
+    }
+    printf(" %14ld\n", usage.ru_maxrss);
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 6 && argc != 7) {
+        fprintf(stderr, "Usage: %s <file.vcf[.gz]> <WINDOW_SIZE> <HAP_SIZE> <OFFSET_SIZE> <numThreads> [samples]\n", argv[0]);
+        return 1;
+    }
+
+    Benchmark bench;
+    memset(&bench, 0, sizeof(Benchmark));
+    bench.file_name = argv[1];
+    bench.WINDOW_SIZE = atoi(argv[2]);
+    bench.HAP_SIZE = atoi(argv[3]);
+    bench.OFFSET_SIZE = atoi(argv[4]);
+    bench.numThreads = atoi(argv[5]);
+    bench.samples = argc == 7 ? argv[6] : NULL;
+
+    printf("\nFile: %s\nHaplotype Size of %d SNPs\nOffset Size of %d Haplotypes\nWindow Size of %d Haplotypes\nInflating with %d Threads\n\n", bench.file_name, bench.HAP_SIZE, bench.OFFSET_SIZE, bench.WINDOW_SIZE, bench.numThreads);
+    printf("%-22s %10s %12s %14s %16s %14s\n", "Stage", "Seconds", "Calls", "Loci/s", "Genotypes/s", "Peak RSS (KB)");
+
+    int failed = 0;
+    failed |= run_stage("get_next_locus", bench_get_next_locus, &bench);
+    failed |= run_stage("get_next_haplotype", bench_get_next_haplotype, &bench);
+    failed |= run_stage("relabel_haplotypes", bench_relabel_haplotypes, &bench);
+    failed |= run_stage("slide_through_genome", bench_slide_through_genome, &bench);
+
+    return failed;
+
+}
@@ -0,0 +1,155 @@
+// File: Check.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Checks that equivalent ways of sliding through a VCF file give the same results.
+
+#include "../src/SlidingWindow.h"
+
+#include <string.h>
+
+// Checks that the 32-bit and 64-bit encoders give the same labels for every haplotype.
+// Accepts:
+//  char* file_name -> The VCF file.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  bool isPacked -> If set, the 32-bit encoder reads packed bitplanes.
+// Returns:
+//  int, The number of haplotypes that differ.
+static int check_wide_haplotypes(char* file_name, int HAP_SIZE, bool isPacked) {
+    VCFGenotypeParser* narrowParser = init_vcf_genotype_parser(file_name, 0);
+    VCFGenotypeParser* wideParser = init_vcf_genotype_parser(file_name, 0);
+    if (isPacked)
+        enable_genotype_packing(narrowParser);
+    HaplotypeEncoder* narrow = init_haplotype_encoder(narrowParser -> num_samples, false);
+    HaplotypeEncoder* wide = init_haplotype_encoder(wideParser -> num_samples, true);
+    int numHaplotypes = 0, numDifferent = 0;
+    while (!(narrowParser -> isEOF) && !(wideParser -> isEOF)) {
+        get_next_haplotype(narrowParser, narrow, true, HAP_SIZE);
+        get_next_haplotype(wideParser, wide, true, HAP_SIZE);
+        numHaplotypes++;
+        if (narrow -> numLoci != wide -> numLoci || narrow -> numLeaves != wide -> numLeaves
+                || memcmp(narrow -> leftHaplotype, wide -> leftHaplotype, narrow -> numSamples * sizeof(unsigned int)) != 0
+                || memcmp(narrow -> rightHaplotype, wide -> rightHaplotype, narrow -> numSamples * sizeof(unsigned int)) != 0)
+            numDifferent++;
+    }
+    if (narrowParser -> isEOF != wideParser -> isEOF)
+        numDifferent++;
+    printf("%-40s HAP_SIZE %4d %8d haplotypes %6d differ\n", isPacked ? "32-bit packed vs 64-bit encoder" : "32-bit vs 64-bit encoder", HAP_SIZE, numHaplotypes, numDifferent);
+    destroy_vcf_genotype_parser(narrowParser);
+    destroy_vcf_genotype_parser(wideParser);
+    destroy_haplotype_encoder(narrow);
+    destroy_haplotype_encoder(wide);
+    return numDifferent;
+}
+
+// Checks that two windows cover the same loci with the same statistics.
+static bool is_same_window(Window* a, Window* b) {
+    return a -> startLocus == b -> startLocus && a -> endLocus == b -> endLocus && a -> numLoci == b -> numLoci
+        && strcmp(ks_str(a -> chromosome), ks_str(b -> chromosome)) == 0
+        && a -> numDistinctHaplotypes == b -> numDistinctHaplotypes && a -> numMissingHaplotypes == b -> numMissingHaplotypes
+        && a -> haplotypeHomozygosity == b -> haplotypeHomozygosity;
+}
+
+// Checks that sliding with the 32-bit and 64-bit encoders gives the same windows.
+// Accepts:
+//  char* file_name -> The VCF file.
+//  int WINDOW_SIZE -> The number of haplotypes in a window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes between windows.
+// Returns:
+//  int, The number of windows that differ.
+static int check_wide_windows(char* file_name, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+    klist_t(WindowPtr)* windows[2];
+    for (int i = 0; i < 2; i++) {
+        VCFGenotypeParser* parser = init_vcf_genotype_parser(file_name, 0);
+        HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, i == 1);
+        windows[i] = slide_through_genome(parser, encoder, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
+        destroy_vcf_genotype_parser(parser);
+        destroy_haplotype_encoder(encoder);
+    }
+    int numWindows = 0, numDifferent = 0;
+    kliter_t(WindowPtr)* a = kl_begin(windows[0]);
+    kliter_t(WindowPtr)* b = kl_begin(windows[1]);
+    for (; a != kl_end(windows[0]) && b != kl_end(windows[1]); a = kl_next(a), b = kl_next(b), numWindows++)
+        if (!is_same_window(kl_val(a), kl_val(b)))
+            numDifferent++;
+    if (a != kl_end(windows[0]) || b != kl_end(windows[1]))
+        numDifferent++;
+    printf("%-40s HAP_SIZE %4d %8d windows    %6d differ\n", "32-bit vs 64-bit windows", HAP_SIZE, numWindows, numDifferent);
+    kl_destroy(WindowPtr, windows[0]);
+    kl_destroy(WindowPtr, windows[1]);
+    return numDifferent;
+}
+
+// Checks that a window of a fixed span has the same statistics whatever the step. Each window
+//  of the widest step is compared to the window with the same start under every other step.
+// Accepts:
+//  char* file_name -> The VCF file.
+//  int WINDOW_SPAN -> The number of bp in a window.
+//  int HAP_SPAN -> The number of bp in a haplotype.
+//  int* STEP_SPANS -> The steps, the widest first.
+//  int numSteps -> The number of steps.
+// Returns:
+//  int, The number of windows that differ.
+static int check_span_windows(char* file_name, int WINDOW_SPAN, int HAP_SPAN, int* STEP_SPANS, int numSteps) {
+    klist_t(WindowPtr)** windows = (klist_t(WindowPtr)**) calloc(numSteps, sizeof(klist_t(WindowPtr)*));
+    for (int i = 0; i < numSteps; i++) {
+        VCFGenotypeParser* parser = init_vcf_genotype_parser(file_name, 0);
+        HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+        windows[i] = slide_through_genome_by_span(parser, encoder, WINDOW_SPAN, HAP_SPAN, STEP_SPANS[i]);
+        destroy_vcf_genotype_parser(parser);
+        destroy_haplotype_encoder(encoder);
+    }
+    int numWindows = 0, numDifferent = 0;
+    for (int i = 1; i < numSteps; i++) {
+        // Both lists are in genome order, so one pass finds the matching windows.
+        kliter_t(WindowPtr)* b = kl_begin(windows[i]);
+        for (kliter_t(WindowPtr)* a = kl_begin(windows[0]); a != kl_end(windows[0]); a = kl_next(a), numWindows++) {
+            while (b != kl_end(windows[i]) && (strcmp(ks_str(kl_val(b) -> chromosome), ks_str(kl_val(a) -> chromosome)) != 0 || kl_val(b) -> startLocus != kl_val(a) -> startLocus))
+                b = kl_next(b);
+            if (b == kl_end(windows[i]) || !is_same_window(kl_val(a), kl_val(b)))
+                numDifferent++;
+            if (b == kl_end(windows[i]))
+                b = kl_begin(windows[i]);
+        }
+    }
+    // Spans that do not tile the windows are rejected.
+    VCFGenotypeParser* parser = init_vcf_genotype_parser(file_name, 0);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+    if (slide_through_genome_by_span(parser, encoder, WINDOW_SPAN, HAP_SPAN, WINDOW_SPAN / 3 + 1) != NULL
+            || slide_through_genome_by_span(parser, encoder, WINDOW_SPAN, WINDOW_SPAN / 2 + 1, WINDOW_SPAN) != NULL)
+        numDifferent++;
+    destroy_vcf_genotype_parser(parser);
+    destroy_haplotype_encoder(encoder);
+    printf("%-40s HAP_SPAN %4d %8d windows    %6d differ\n", "Span windows across steps", HAP_SPAN, numWindows, numDifferent);
+    for (int i = 0; i < numSteps; i++)
+        kl_destroy(WindowPtr, windows[i]);
+    free(windows);
+    return numDifferent;
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <file.vcf[.gz]>\n", argv[0]);
+        return 1;
+    }
+
+    // Long haplotypes relabel the 32-bit tree mid-haplotype, after missing genotypes
+    //  have collapsed samples to the missing leaf.
+    int numDifferent = 0;
+    int hapSizes[] = {1, 10, 100, 200};
+    for (int i = 0; i < 4; i++) {
+        numDifferent += check_wide_haplotypes(argv[1], hapSizes[i], false);
+        numDifferent += check_wide_haplotypes(argv[1], hapSizes[i], true);
+        numDifferent += check_wide_windows(argv[1], 5, hapSizes[i], 2);
+    }
+
+    // Windows of 20 kbp stepping by the whole window down to a single haplotype.
+    int stepSpans[] = {20000, 10000, 5000, 1000};
+    numDifferent += check_span_windows(argv[1], 20000, 1000, stepSpans, 4);
+
+    if (numDifferent > 0)
+        fprintf(stderr, "%d checks differ.\n", numDifferent);
+    return numDifferent > 0;
+
+}
@@ -0,0 +1,272 @@
+// File: GenerateVCF.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Generates a deterministic synthetic VCF file to benchmark the sliding window.
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <stdarg.h>
+
+#include <stdbool.h>
+
+// Supports writing BGZF blocks.
+#include "../klib/zlib.h"
+
+// Uncompressed bytes per BGZF block. Leaves room for incompressible data to fit in a 64KB block.
+#define BGZF_BLOCK_INPUT_SIZE 65280
+
+// The maximum size of a BGZF block.
+#define BGZF_MAX_BLOCK_SIZE 65536
+
+// The empty block that marks the end of a BGZF file.
+static const unsigned char BGZF_EOF[28] = { 0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 0x06, 0, 0x42, 0x43, 0x02, 0, 0x1b, 0, 0x03, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+
+// Writes the file, either as plain text or as BGZF blocks.
+typedef struct {
+    FILE* file;
+    // Set if the file name ends in .gz.
+    bool isBGZF;
+    // The uncompressed contents of the current block.
+    unsigned char* block;
+    // The number of bytes in the current block.
+    int length;
+    // Holds a compressed block.
+    unsigned char* compressed;
+} Writer;
+
+// Compresses the current block and writes it to the file.
+static void flush_block(Writer* writer) {
+    if (writer -> length == 0)
+        return;
+    if (!writer -> isBGZF) {
+        fwrite(writer -> block, 1, writer -> length, writer -> file);
+        writer -> length = 0;
+        return;
+    }
+    z_stream stream;
+    memset(&stream, 0, sizeof(z_stream));
+    deflateInit2(&stream, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    stream.next_in = writer -> block;
+    stream.avail_in = writer -> length;
+    stream.next_out = writer -> compressed + 18;
+    stream.avail_out = BGZF_MAX_BLOCK_SIZE - 18 - 8;
+    deflate(&stream, Z_FINISH);
+    int blockSize = 18 + stream.total_out + 8;
+    deflateEnd(&stream);
+    // The header is a gzip header with the BC extra field holding the block size - 1.
+    static const unsigned char header[16] = { 0x1f, 0x8b, 0x08, 0x04, 0, 0, 0, 0, 0, 0xff, 0x06, 0, 0x42, 0x43, 0x02, 0 };
+    memcpy(writer -> compressed, header, 16);
+    writer -> compressed[16] = (blockSize - 1) & 0xFF;
+    writer -> compressed[17] = (blockSize - 1) >> 8;
+    // The footer is the CRC32 and the size of the uncompressed data.
+    unsigned int crc = crc32(crc32(0, NULL, 0), writer -> block, writer -> length);
+    unsigned char* footer = writer -> compressed + blockSize - 8;
+    for (int i = 0; i < 4; i++) {
+        footer[i] = (crc >> (8 * i)) & 0xFF;
+        footer[4 + i] = ((unsigned int) writer -> length >> (8 * i)) & 0xFF;
+    }
+    fwrite(writer -> compressed, 1, blockSize, writer -> file);
+    writer -> length = 0;
+}
+
+// Appends bytes to the file.
+static void write_bytes(Writer* writer, const char* bytes, int length) {
+    while (length > 0) {
+        int n = BGZF_BLOCK_INPUT_SIZE - writer -> length < length ? BGZF_BLOCK_INPUT_SIZE - writer -> length : length;
+        memcpy(writer -> block + writer -> length, bytes, n);
+        writer -> length += n;
+        bytes += n;
+        length -= n;
+        if (writer -> length == BGZF_BLOCK_INPUT_SIZE)
+            flush_block(writer);
+    }
+}
+
+// Appends formatted text to the file.
+static void write_format(Writer* writer, const char* format, ...) {
+    char text[256];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(text, sizeof(text), format, args);
+    va_end(args);
+    write_bytes(writer, text, length);
+}
+
+// The maximum distance between two consecutive loci.
+#define MAX_POSITION_STEP 100
+
+// The number of founder haplotypes samples copy from. Gives the samples shared haplotypes
+//  instead of independent genotypes, so relabeling sees realistic numbers of distinct haplotypes.
+#define NUM_FOUNDERS 16
+
+// The probability a sample switches founders between two loci.
+#define SWITCH_RATE 0.01
+
+// The probability a copied allele is mutated.
+#define MUTATION_RATE 0.005
+
+// The nucleotides used for REF and ALT alleles.
+static const char NUCLEOTIDES[] = "ACGT";
+
+// xorshift64* generator. The same seed always creates the same file.
+static unsigned long long state;
+
+static unsigned long long next_random() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+// Returns a uniform double in [0, 1).
+static double next_uniform() {
+    return (next_random() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Writes an allele index of at most two digits to the buffer.
+// Returns:
+//  char*, The end of the written allele.
+static char* write_index(char* buffer, int i) {
+    if (i >= 10)
+        *buffer++ = '0' + i / 10;
+    *buffer++ = '0' + i % 10;
+    return buffer;
+}
+
+// Writes allele index i at a locus with reference nucleotide ref.
+//  Alleles past the nucleotides are written as insertions.
+static void write_allele(Writer* out, int ref, int i) {
+    int n = (ref + i) % 4;
+    if (i < 4) {
+        write_bytes(out, &NUCLEOTIDES[n], 1);
+    } else {
+        write_bytes(out, &NUCLEOTIDES[ref], 1);
+        for (int j = 0; j < i / 4; j++)
+            write_bytes(out, &NUCLEOTIDES[n], 1);
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 8) {
+        fprintf(stderr, "Usage: %s <out.vcf[.gz]> <numSamples> <numSites> <maxAlleles> <missingness> <numContigs> <seed>\n", argv[0]);
+        return 1;
+    }
+
+    int numSamples = atoi(argv[2]), numSites = atoi(argv[3]), maxAlleles = atoi(argv[4]), numContigs = atoi(argv[6]);
+    double missingness = atof(argv[5]);
+    state = strtoull(argv[7], NULL, 10) * 0x9E3779B97F4A7C15ULL + 1;
+
+    // A GENOTYPE holds at most 15 alleles and the missing allele.
+    if (numSamples < 1 || numSites < 1 || maxAlleles < 2 || maxAlleles > 15 || numContigs < 1 || missingness < 0 || missingness > 1) {
+        fprintf(stderr, "Invalid arguments. Requires samples >= 1, sites >= 1, 2 <= alleles <= 15, 0 <= missingness <= 1, and contigs >= 1.\n");
+        return 1;
+    }
+
+    // Files ending in .gz are written in BGZF, so they can be inflated in parallel.
+    Writer* out = (Writer*) calloc(1, sizeof(Writer));
+    out -> file = fopen(argv[1], "wb");
+    if (out -> file == NULL) {
+        fprintf(stderr, "Could not open %s.\n", argv[1]);
+        return 1;
+    }
+    int nameLength = strlen(argv[1]);
+    out -> isBGZF = nameLength > 3 && strcmp(argv[1] + nameLength - 3, ".gz") == 0;
+    out -> block = (unsigned char*) malloc(BGZF_BLOCK_INPUT_SIZE);
+    out -> compressed = (unsigned char*) malloc(BGZF_MAX_BLOCK_SIZE);
+
+    // Each haplotype of each sample copies from a founder.
+    int* founders = (int*) malloc(2 * numSamples * sizeof(int));
+    for (int i = 0; i < 2 * numSamples; i++)
+        founders[i] = next_random() % NUM_FOUNDERS;
+    int* founderAlleles = (int*) malloc(NUM_FOUNDERS * sizeof(int));
+
+    // The genotypes of a site are formatted into a buffer. Each is at most "\t14|14".
+    char* genotypes = (char*) malloc(6 * numSamples + 1);
+
+    // Write header.
+    write_format(out, "##fileformat=VCFv4.2\n");
+    write_format(out, "##source=GenerateVCF\n");
+    for (int i = 0; i < numContigs; i++)
+        write_format(out, "##contig=<ID=chr%d>\n", i + 1);
+    write_format(out, "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">\n");
+    write_format(out, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT");
+    for (int i = 0; i < numSamples; i++)
+        write_format(out, "\tS%d", i + 1);
+    write_bytes(out, "\n", 1);
+
+    // The sites are split evenly across the contigs.
+    int sitesPerContig = (numSites + numContigs - 1) / numContigs;
+
+    for (int site = 0, position = 0; site < numSites; site++) {
+
+        if (site % sitesPerContig == 0)
+            position = 0;
+        position += 1 + next_random() % MAX_POSITION_STEP;
+
+        // Most sites are biallelic. The rest have up to maxAlleles alleles.
+        int numAlleles = 2;
+        if (maxAlleles > 2 && next_uniform() < 0.1)
+            numAlleles = 3 + next_random() % (maxAlleles - 2);
+        int ref = next_random() % 4;
+
+        write_format(out, "chr%d\t%d\t.\t", site / sitesPerContig + 1, position);
+        write_allele(out, ref, 0);
+        write_bytes(out, "\t", 1);
+        for (int i = 1; i < numAlleles; i++) {
+            if (i > 1)
+                write_bytes(out, ",", 1);
+            write_allele(out, ref, i);
+        }
+        write_format(out, "\t.\tPASS\t.\tGT");
+
+        // Founders carry the reference allele with a random frequency and the alternates evenly.
+        double referenceFrequency = next_uniform();
+        for (int i = 0; i < NUM_FOUNDERS; i++)
+            founderAlleles[i] = next_uniform() < referenceFrequency ? 0 : 1 + next_random() % (numAlleles - 1);
+
+        char* g = genotypes;
+        for (int i = 0; i < numSamples; i++) {
+            int alleles[2];
+            for (int j = 0; j < 2; j++) {
+                if (next_uniform() < SWITCH_RATE)
+                    founders[2 * i + j] = next_random() % NUM_FOUNDERS;
+                alleles[j] = founderAlleles[founders[2 * i + j]];
+                if (next_uniform() < MUTATION_RATE)
+                    alleles[j] = next_random() % numAlleles;
+            }
+            *g++ = '\t';
+            if (next_uniform() < missingness) {
+                *g++ = '.';
+                *g++ = '|';
+                *g++ = '.';
+            } else {
+                g = write_index(g, alleles[0]);
+                *g++ = '|';
+                g = write_index(g, alleles[1]);
+            }
+        }
+        *g++ = '\n';
+        write_bytes(out, genotypes, g - genotypes);
+
+    }
+
+    free(founders);
+    free(founderAlleles);
+    free(genotypes);
+
+    flush_block(out);
+    if (out -> isBGZF)
+        fwrite(BGZF_EOF, 1, sizeof(BGZF_EOF), out -> file);
+    int status = fclose(out -> file) == 0 ? 0 : 1;
+    free(out -> block);
+    free(out -> compressed);
+    free(out);
+
+    return status;
+
+}
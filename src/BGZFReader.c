@@ -0,0 +1,455 @@
+// File: BGZFReader.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Read a BGZF compressed file by inflating its blocks on a pool of threads.
+
+#include <string.h>
+
+#include "BGZFReader.h"
+
+#include "Instrumentation.h"
+
+// Checks if a header is the header of a BGZF block.
+// Accepts:
+//  unsigned char* header -> The first BGZF_HEADER_SIZE bytes of a block.
+// Returns:
+//  bool, True if the gzip header contains the BC extra subfield.
+static bool is_bgzf_header(unsigned char* header) {
+    return header[0] == 31 && header[1] == 139 && header[2] == 8 && (header[3] & 4) != 0
+            && header[10] == 6 && header[11] == 0 && header[12] == 'B' && header[13] == 'C'
+            && header[14] == 2 && header[15] == 0;
+}
+
+// Inflates a compressed block.
+// Accepts:
+//  z_stream* stream -> A raw inflate stream owned by the caller.
+//  BGZFBlock* block -> The block to inflate.
+// Returns:
+//  bool, True if the block was inflated and its CRC32 and size match the footer.
+static bool inflate_block(z_stream* stream, BGZFBlock* block) {
+    unsigned char* footer = block -> compressed + block -> compressedLength - BGZF_FOOTER_SIZE;
+    unsigned int crc = footer[0] | (footer[1] << 8) | (footer[2] << 16) | ((unsigned int) footer[3] << 24);
+    unsigned int inflatedSize = footer[4] | (footer[5] << 8) | (footer[6] << 16) | ((unsigned int) footer[7] << 24);
+    if (inflatedSize > BGZF_MAX_BLOCK_SIZE)
+        return false;
+
+    // Inflate the deflate stream between the header and the footer.
+    INSTRUMENT_START(timer);
+    inflateReset(stream);
+    stream -> next_in = block -> compressed + BGZF_HEADER_SIZE;
+    stream -> avail_in = block -> compressedLength - BGZF_HEADER_SIZE - BGZF_FOOTER_SIZE;
+    stream -> next_out = block -> inflated;
+    stream -> avail_out = BGZF_MAX_BLOCK_SIZE;
+    int ret = inflate(stream, Z_FINISH);
+    INSTRUMENT_STOP(STAGE_INFLATE, timer);
+    if (ret != Z_STREAM_END)
+        return false;
+    block -> inflatedLength = BGZF_MAX_BLOCK_SIZE - stream -> avail_out;
+    INSTRUMENT_INFLATED(block -> inflatedLength);
+
+    // Make sure the block is intact.
+    return block -> inflatedLength == inflatedSize && crc32(crc32(0L, Z_NULL, 0), block -> inflated, block -> inflatedLength) == crc;
+}
+
+// Creates a raw inflate stream.
+// Accepts:
+//  void.
+// Returns:
+//  z_stream*, The stream or NULL if zlib could not be initialized.
+static z_stream* init_inflate_stream() {
+    z_stream* stream = (z_stream*) calloc(1, sizeof(z_stream));
+    if (inflateInit2(stream, -15) != Z_OK) {
+        free(stream);
+        return NULL;
+    }
+    return stream;
+}
+
+// Frees a raw inflate stream.
+// Accepts:
+//  z_stream* stream -> The stream to free.
+// Returns:
+//  void.
+static void destroy_inflate_stream(z_stream* stream) {
+    if (stream == NULL)
+        return;
+    inflateEnd(stream);
+    free(stream);
+}
+
+// The routine run by each worker thread. Inflates filled blocks in file order.
+// Accepts:
+//  void* arg -> The BGZFReader.
+// Returns:
+//  void*, Always NULL.
+static void* inflate_worker(void* arg) {
+    BGZFReader* reader = (BGZFReader*) arg;
+    z_stream* stream = init_inflate_stream();
+
+    pthread_mutex_lock(&(reader -> lock));
+    while (true) {
+        // Wait until the next block in the ring is ready to be inflated.
+        while (!(reader -> isShutdown) && reader -> blocks[reader -> nextToInflate].state != BLOCK_FILLED)
+            pthread_cond_wait(&(reader -> blockFilled), &(reader -> lock));
+        if (reader -> isShutdown)
+            break;
+
+        // Claim the block.
+        BGZFBlock* block = &(reader -> blocks[reader -> nextToInflate]);
+        block -> state = BLOCK_INFLATING;
+        reader -> nextToInflate = (reader -> nextToInflate + 1) % reader -> numBlocks;
+
+        // Inflate without holding the lock.
+        pthread_mutex_unlock(&(reader -> lock));
+        bool isInflated = stream != NULL && inflate_block(stream, block);
+        pthread_mutex_lock(&(reader -> lock));
+
+        block -> state = isInflated ? BLOCK_READY : BLOCK_ERROR;
+        pthread_cond_broadcast(&(reader -> blockInflated));
+    }
+    pthread_mutex_unlock(&(reader -> lock));
+
+    destroy_inflate_stream(stream);
+    return NULL;
+}
+
+// Reads the next compressed block from the file.
+// Accepts:
+//  BGZFReader* reader -> The reader.
+//  BGZFBlock* block -> The block to fill.
+// Returns:
+//  int, 1 if a block was read, 0 on EOF, and -1 if the file is malformed.
+static int read_block(BGZFReader* reader, BGZFBlock* block) {
+    // Read in the header.
+    size_t numRead = fread(block -> compressed, 1, BGZF_HEADER_SIZE, reader -> file);
+    if (numRead == 0)
+        return 0;
+    if (numRead != BGZF_HEADER_SIZE || !is_bgzf_header(block -> compressed))
+        return -1;
+
+    // Read in the rest of the block.
+    int blockSize = (block -> compressed[16] | (block -> compressed[17] << 8)) + 1;
+    if (blockSize < BGZF_HEADER_SIZE + BGZF_FOOTER_SIZE)
+        return -1;
+    if (fread(block -> compressed + BGZF_HEADER_SIZE, 1, blockSize - BGZF_HEADER_SIZE, reader -> file) != blockSize - BGZF_HEADER_SIZE)
+        return -1;
+    block -> compressedLength = blockSize;
+    block -> fileOffset = reader -> nextFileOffset;
+    reader -> nextFileOffset += blockSize;
+    return 1;
+}
+
+// Fills all empty blocks in the ring with compressed blocks from the file.
+// Accepts:
+//  BGZFReader* reader -> The reader.
+// Returns:
+//  void.
+static void fill_blocks(BGZFReader* reader) {
+    while (!(reader -> isFileEOF)) {
+        // The consumer owns empty blocks, so the block can be filled without the lock.
+        pthread_mutex_lock(&(reader -> lock));
+        bool isEmpty = reader -> blocks[reader -> tail].state == BLOCK_EMPTY;
+        pthread_mutex_unlock(&(reader -> lock));
+        if (!isEmpty)
+            return;
+
+        BGZFBlock* block = &(reader -> blocks[reader -> tail]);
+        int ret = read_block(reader, block);
+        if (ret == 0) {
+            reader -> isFileEOF = true;
+            return;
+        }
+
+        // A malformed block is passed along as an error so the consumer sees it in order.
+        pthread_mutex_lock(&(reader -> lock));
+        if (ret < 0) {
+            block -> state = BLOCK_ERROR;
+            reader -> isFileEOF = true;
+        } else {
+            block -> state = BLOCK_FILLED;
+        }
+        pthread_cond_signal(&(reader -> blockFilled));
+        pthread_mutex_unlock(&(reader -> lock));
+        reader -> tail = (reader -> tail + 1) % reader -> numBlocks;
+    }
+}
+
+// Adds the block at head to the log. The log is read by other threads, so it is locked.
+// Accepts:
+//  BGZFReader* reader -> The reader.
+// Returns:
+//  void.
+static void log_block(BGZFReader* reader) {
+    BGZFBlock* block = &(reader -> blocks[reader -> head]);
+    pthread_mutex_lock(&(reader -> lock));
+    if (reader -> numLoggedBlocks == reader -> maxLoggedBlocks) {
+        reader -> maxLoggedBlocks = reader -> maxLoggedBlocks == 0 ? 16 : 2 * reader -> maxLoggedBlocks;
+        reader -> blockLog = (BGZFBlockStart*) realloc(reader -> blockLog, reader -> maxLoggedBlocks * sizeof(BGZFBlockStart));
+    }
+    BGZFBlockStart* start = &(reader -> blockLog[reader -> numLoggedBlocks++]);
+    start -> inflatedOffset = reader -> headInflatedOffset;
+    start -> fileOffset = block -> fileOffset;
+    start -> compressedLength = block -> compressedLength;
+    start -> inflatedLength = block -> inflatedLength;
+    pthread_mutex_unlock(&(reader -> lock));
+}
+
+// Moves the consumer to the next inflated block.
+// Accepts:
+//  BGZFReader* reader -> The reader.
+// Returns:
+//  int, 1 if there is a next block, 0 on EOF, and -1 if the block could not be inflated.
+static int next_block(BGZFReader* reader) {
+    // Release the block we have consumed.
+    if (reader -> isHoldingBlock) {
+        pthread_mutex_lock(&(reader -> lock));
+        reader -> blocks[reader -> head].state = BLOCK_EMPTY;
+        pthread_mutex_unlock(&(reader -> lock));
+        reader -> headInflatedOffset += reader -> blocks[reader -> head].inflatedLength;
+        reader -> head = (reader -> head + 1) % reader -> numBlocks;
+        reader -> isHoldingBlock = false;
+    }
+
+    // Keep the workers busy.
+    fill_blocks(reader);
+
+    BGZFBlock* block = &(reader -> blocks[reader -> head]);
+
+    // Without workers, the consumer inflates the block.
+    if (reader -> numThreads == 0 && block -> state == BLOCK_FILLED) {
+        reader -> nextToInflate = (reader -> nextToInflate + 1) % reader -> numBlocks;
+        block -> state = inflate_block(reader -> stream, block) ? BLOCK_READY : BLOCK_ERROR;
+    }
+
+    // Wait for the block to be inflated.
+    pthread_mutex_lock(&(reader -> lock));
+    while (block -> state == BLOCK_FILLED || block -> state == BLOCK_INFLATING)
+        pthread_cond_wait(&(reader -> blockInflated), &(reader -> lock));
+    BLOCK_STATE state = block -> state;
+    pthread_mutex_unlock(&(reader -> lock));
+
+    // If the block is empty, all the blocks in the file were consumed.
+    if (state == BLOCK_EMPTY)
+        return 0;
+    if (state == BLOCK_ERROR)
+        return -1;
+    reader -> isHoldingBlock = true;
+    reader -> blockOffset = 0;
+    if (reader -> isLoggingBlocks)
+        log_block(reader);
+    return 1;
+}
+
+BGZFReader* init_bgzf_reader(char* file_name, int numThreads) {
+
+    // Try to open file.
+    FILE* file = fopen(file_name, "rb");
+    if (file == NULL)
+        return NULL;
+
+    // Check if the first block is a BGZF block.
+    unsigned char header[BGZF_HEADER_SIZE];
+    bool isBGZF = fread(header, 1, BGZF_HEADER_SIZE, file) == BGZF_HEADER_SIZE && is_bgzf_header(header);
+    rewind(file);
+
+    BGZFReader* reader = (BGZFReader*) calloc(1, sizeof(BGZFReader));
+    reader -> isBGZF = isBGZF;
+
+    // If not BGZF, then zlib reads the file. gzread also reads uncompressed files.
+    if (!isBGZF) {
+        fclose(file);
+        reader -> gzfile = gzopen(file_name, "r");
+        if (reader -> gzfile == NULL) {
+            free(reader);
+            return NULL;
+        }
+        return reader;
+    }
+
+    reader -> file = file;
+    reader -> numThreads = numThreads < 0 ? 0 : numThreads;
+
+    // Allocate the ring of blocks.
+    reader -> numBlocks = reader -> numThreads == 0 ? 1 : BGZF_BLOCKS_PER_THREAD * reader -> numThreads;
+    reader -> blocks = (BGZFBlock*) calloc(reader -> numBlocks, sizeof(BGZFBlock));
+    for (int i = 0; i < reader -> numBlocks; i++) {
+        reader -> blocks[i].compressed = (unsigned char*) malloc(BGZF_MAX_BLOCK_SIZE);
+        reader -> blocks[i].inflated = (unsigned char*) malloc(BGZF_MAX_BLOCK_SIZE);
+    }
+
+    pthread_mutex_init(&(reader -> lock), NULL);
+    pthread_cond_init(&(reader -> blockFilled), NULL);
+    pthread_cond_init(&(reader -> blockInflated), NULL);
+
+    // Start the workers, or create the consumer's stream if there are none.
+    if (reader -> numThreads == 0) {
+        reader -> stream = init_inflate_stream();
+    } else {
+        reader -> threads = (pthread_t*) calloc(reader -> numThreads, sizeof(pthread_t));
+        for (int i = 0; i < reader -> numThreads; i++)
+            pthread_create(&(reader -> threads[i]), NULL, inflate_worker, reader);
+    }
+
+    // Start reading ahead.
+    fill_blocks(reader);
+
+    return reader;
+
+}
+
+int bgzf_read(BGZFReader* reader, void* buffer, unsigned int length) {
+
+    if (!(reader -> isBGZF)) {
+        INSTRUMENT_START(timer);
+        int numRead = gzread(reader -> gzfile, buffer, length);
+        INSTRUMENT_STOP(STAGE_INFLATE, timer);
+        INSTRUMENT_INFLATED(numRead > 0 ? numRead : 0);
+        return numRead;
+    }
+
+    // Copy from the inflated blocks until the buffer is full.
+    unsigned int numCopied = 0;
+    while (numCopied < length) {
+        // Move to the next block when the current one is consumed.
+        if (!(reader -> isHoldingBlock) || reader -> blockOffset == reader -> blocks[reader -> head].inflatedLength) {
+            int ret = next_block(reader);
+            if (ret < 0)
+                return -1;
+            if (ret == 0)
+                break;
+            continue;
+        }
+        BGZFBlock* block = &(reader -> blocks[reader -> head]);
+        int numToCopy = block -> inflatedLength - reader -> blockOffset;
+        if (numToCopy > length - numCopied)
+            numToCopy = length - numCopied;
+        memcpy((char*) buffer + numCopied, block -> inflated + reader -> blockOffset, numToCopy);
+        reader -> blockOffset += numToCopy;
+        numCopied += numToCopy;
+    }
+
+    return numCopied;
+
+}
+
+bool bgzf_seek(BGZFReader* reader, unsigned long long virtualOffset) {
+
+    if (!(reader -> isBGZF))
+        return false;
+
+    // Let the workers finish the blocks in flight, then empty the ring.
+    pthread_mutex_lock(&(reader -> lock));
+    while (true) {
+        bool isInflating = false;
+        for (int i = 0; i < reader -> numBlocks; i++)
+            isInflating |= reader -> blocks[i].state == BLOCK_INFLATING;
+        if (!isInflating)
+            break;
+        pthread_cond_wait(&(reader -> blockInflated), &(reader -> lock));
+    }
+    for (int i = 0; i < reader -> numBlocks; i++)
+        reader -> blocks[i].state = BLOCK_EMPTY;
+    reader -> head = reader -> tail = reader -> nextToInflate = 0;
+    pthread_mutex_unlock(&(reader -> lock));
+    reader -> isHoldingBlock = false;
+    reader -> isFileEOF = false;
+    // Inflated offsets are no longer known. Logging is restarted by the owner.
+    reader -> isLoggingBlocks = false;
+    reader -> numLoggedBlocks = 0;
+
+    // The upper 48 bits are the offset of the block in the file.
+    if (fseeko(reader -> file, (off_t) (virtualOffset >> 16), SEEK_SET) != 0)
+        return false;
+    reader -> nextFileOffset = virtualOffset >> 16;
+
+    // The lower 16 bits are the offset into the inflated block.
+    int blockOffset = virtualOffset & 0xFFFF;
+    if (next_block(reader) <= 0)
+        return blockOffset == 0;
+    if (blockOffset > reader -> blocks[reader -> head].inflatedLength)
+        return false;
+    reader -> blockOffset = blockOffset;
+    return true;
+
+}
+
+bool bgzf_log_blocks(BGZFReader* reader, long long inflatedOffset) {
+
+    if (!(reader -> isBGZF))
+        return false;
+
+    reader -> isLoggingBlocks = true;
+    reader -> numLoggedBlocks = 0;
+    // The next byte is in the block at head, or starts the next block.
+    reader -> headInflatedOffset = inflatedOffset - reader -> blockOffset;
+    if (reader -> isHoldingBlock)
+        log_block(reader);
+    else
+        reader -> headInflatedOffset = inflatedOffset;
+    return true;
+
+}
+
+bool bgzf_virtual_offset(BGZFReader* reader, long long inflatedOffset, unsigned long long* virtualOffset) {
+
+    if (!(reader -> isBGZF))
+        return false;
+
+    pthread_mutex_lock(&(reader -> lock));
+    // Find the last block that starts at or before the offset.
+    int i = reader -> numLoggedBlocks - 1;
+    while (i >= 0 && reader -> blockLog[i].inflatedOffset > inflatedOffset)
+        i--;
+    bool isFound = reader -> isLoggingBlocks && i >= 0 && inflatedOffset <= reader -> blockLog[i].inflatedOffset + reader -> blockLog[i].inflatedLength;
+    if (isFound) {
+        BGZFBlockStart* start = &(reader -> blockLog[i]);
+        long long offsetInBlock = inflatedOffset - start -> inflatedOffset;
+        // The end of a block is the start of the next one.
+        if (offsetInBlock == start -> inflatedLength)
+            *virtualOffset = (unsigned long long) (start -> fileOffset + start -> compressedLength) << 16;
+        else
+            *virtualOffset = ((unsigned long long) start -> fileOffset << 16) | offsetInBlock;
+        // Forget the blocks before it.
+        memmove(reader -> blockLog, start, (reader -> numLoggedBlocks - i) * sizeof(BGZFBlockStart));
+        reader -> numLoggedBlocks -= i;
+    }
+    pthread_mutex_unlock(&(reader -> lock));
+    return isFound;
+
+}
+
+void destroy_bgzf_reader(BGZFReader* reader) {
+    if (reader == NULL)
+        return;
+
+    if (!(reader -> isBGZF)) {
+        gzclose(reader -> gzfile);
+        free(reader);
+        return;
+    }
+
+    // Shutdown and join the workers.
+    pthread_mutex_lock(&(reader -> lock));
+    reader -> isShutdown = true;
+    pthread_cond_broadcast(&(reader -> blockFilled));
+    pthread_mutex_unlock(&(reader -> lock));
+    for (int i = 0; i < reader -> numThreads; i++)
+        pthread_join(reader -> threads[i], NULL);
+    free(reader -> threads);
+    destroy_inflate_stream(reader -> stream);
+
+    pthread_mutex_destroy(&(reader -> lock));
+    pthread_cond_destroy(&(reader -> blockFilled));
+    pthread_cond_destroy(&(reader -> blockInflated));
+
+    // Free the ring of blocks.
+    for (int i = 0; i < reader -> numBlocks; i++) {
+        free(reader -> blocks[i].compressed);
+        free(reader -> blocks[i].inflated);
+    }
+    free(reader -> blocks);
+    free(reader -> blockLog);
+
+    fclose(reader -> file);
+    free(reader);
+}
@@ -0,0 +1,181 @@
+// File: BGZFReader.h
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Read a BGZF compressed file by inflating its blocks on a pool of threads.
+
+#ifndef _BGZF_READER_
+#define _BGZF_READER_
+
+#include <stdlib.h>
+
+#include <stdio.h>
+
+#include <stdbool.h>
+
+#include <pthread.h>
+
+// Supports GZIP VCF files.
+#include "../klib/zlib.h"
+
+// The maximum size of a BGZF block, compressed or inflated.
+#define BGZF_MAX_BLOCK_SIZE 65536
+
+// The size of the header of a BGZF block.
+#define BGZF_HEADER_SIZE 18
+
+// The size of the CRC32 and ISIZE trailer of a BGZF block.
+#define BGZF_FOOTER_SIZE 8
+
+// The number of blocks each thread can inflate ahead of the consumer.
+#define BGZF_BLOCKS_PER_THREAD 4
+
+// The state of a block in the read ahead ring.
+typedef enum {
+    // Slot is free to be filled by the consumer.
+    BLOCK_EMPTY,
+    // Slot holds a compressed block waiting for a worker.
+    BLOCK_FILLED,
+    // A worker is inflating the block.
+    BLOCK_INFLATING,
+    // The block was inflated and can be consumed.
+    BLOCK_READY,
+    // The block could not be inflated.
+    BLOCK_ERROR
+} BLOCK_STATE;
+
+// A BGZF block in the read ahead ring.
+typedef struct {
+    // The state of the block.
+    BLOCK_STATE state;
+    // The compressed block including header and footer.
+    unsigned char* compressed;
+    // The number of bytes in the compressed block.
+    int compressedLength;
+    // The inflated contents of the block.
+    unsigned char* inflated;
+    // The number of bytes in the inflated block.
+    int inflatedLength;
+    // The offset of the block in the file.
+    long long fileOffset;
+} BGZFBlock;
+
+// Where a block starts in the file and in the inflated stream.
+typedef struct {
+    long long inflatedOffset;
+    long long fileOffset;
+    // The number of compressed and inflated bytes in the block.
+    int compressedLength;
+    int inflatedLength;
+} BGZFBlockStart;
+
+// Our reader structure.
+typedef struct {
+    // Set if the file is in BGZF format. Otherwise, we fall back to zlib's gzread.
+    bool isBGZF;
+    // Used when the file is not in BGZF format.
+    gzFile gzfile;
+    // The raw file the BGZF blocks are read from.
+    FILE* file;
+    // Set when there are no more blocks in the file.
+    bool isFileEOF;
+    // The number of bytes a kstream reading the file asks for at a time. Set by its owner.
+    int bufferSize;
+
+    // The number of worker threads. If 0, blocks are inflated by the consumer.
+    int numThreads;
+    // The worker threads.
+    pthread_t* threads;
+    // The worker's stream used when the consumer inflates blocks.
+    z_stream* stream;
+
+    // The ring of blocks read ahead of the consumer.
+    BGZFBlock* blocks;
+    // The number of blocks in the ring.
+    int numBlocks;
+    // The next block the consumer reads from.
+    int head;
+    // The next block the consumer fills from the file.
+    int tail;
+    // The next block a worker will inflate.
+    int nextToInflate;
+    // Set if the consumer is currently reading the block at head.
+    bool isHoldingBlock;
+    // The offset into the inflated block at head.
+    int blockOffset;
+    // The offset in the file of the next block read from the file.
+    long long nextFileOffset;
+
+    // If set, the consumer logs where each block starts, so an inflated offset can be
+    //  turned into a virtual offset. See bgzf_log_blocks.
+    bool isLoggingBlocks;
+    // The inflated offset of the block at head.
+    long long headInflatedOffset;
+    // The blocks since the last call to bgzf_virtual_offset, in file order.
+    BGZFBlockStart* blockLog;
+    int numLoggedBlocks;
+    int maxLoggedBlocks;
+
+    // Protects the states of the blocks.
+    pthread_mutex_t lock;
+    // Signals workers that a block is ready to inflate or to shutdown.
+    pthread_cond_t blockFilled;
+    // Signals the consumer that a block was inflated.
+    pthread_cond_t blockInflated;
+    // Set to shutdown the workers.
+    bool isShutdown;
+} BGZFReader;
+
+// Creates a BGZFReader.
+// Accepts:
+//  char* file_name -> The name of the file to read in.
+//  int numThreads -> The number of threads used to inflate blocks. If 0, blocks are inflated on read.
+// Returns:
+//  The created reader or NULL if file does not exist.
+BGZFReader* init_bgzf_reader(char* file_name, int numThreads);
+
+// Reads inflated bytes from the file. Has the same contract as gzread so it can drive a kstream.
+// Accepts:
+//  BGZFReader* reader -> A pointer to the reader.
+//  void* buffer -> The buffer to fill.
+//  unsigned int length -> The maximum number of bytes to read.
+// Returns:
+//  int, The number of bytes read, 0 on EOF, or -1 if a block could not be inflated.
+int bgzf_read(BGZFReader* reader, void* buffer, unsigned int length);
+
+// Moves the reader to a virtual offset, as stored in tabix and CSI indices.
+// Accepts:
+//  BGZFReader* reader -> A pointer to the reader.
+//  unsigned long long virtualOffset -> The offset of the block in the file shifted left 16 bits,
+//                                      OR'd with the offset into the inflated block.
+// Returns:
+//  bool, False if the file is not in BGZF format or the offset is past the end of the file.
+bool bgzf_seek(BGZFReader* reader, unsigned long long virtualOffset);
+
+// Logs where each block consumed from now on starts, so bgzf_virtual_offset can find
+//  the virtual offset of an inflated offset.
+// Accepts:
+//  BGZFReader* reader -> A pointer to the reader.
+//  long long inflatedOffset -> The inflated offset of the next byte bgzf_read returns. Inflated
+//                              offsets are counted from this byte on.
+// Returns:
+//  bool, False if the file is not in BGZF format.
+bool bgzf_log_blocks(BGZFReader* reader, long long inflatedOffset);
+
+// Finds the virtual offset of an inflated offset in a logged block. The blocks before it
+//  are forgotten, so offsets must be asked for in increasing order.
+// Accepts:
+//  BGZFReader* reader -> A pointer to the reader.
+//  long long inflatedOffset -> The inflated offset. Must not be before the last one asked for.
+//  unsigned long long* virtualOffset -> Set to the virtual offset.
+// Returns:
+//  bool, False if blocks are not logged or the offset is not in a logged block.
+bool bgzf_virtual_offset(BGZFReader* reader, long long inflatedOffset, unsigned long long* virtualOffset);
+
+// Deallocate all the memory occupied by the BGZFReader and join its threads.
+// Accepts:
+//  BGZFReader* reader -> The reader to destroy.
+// Returns:
+//  void.
+void destroy_bgzf_reader(BGZFReader* reader);
+
+#endif
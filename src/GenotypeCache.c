@@ -0,0 +1,206 @@
+// File: GenotypeCache.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: A binary, columnar copy of the genotypes in a VCF file for repeated scans.
+
+#include <stdio.h>
+
+#include <string.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <sys/stat.h>
+
+#include "GenotypeCache.h"
+
+#include "VCFGenotypeParser.h"
+
+// Rounds an offset up to a multiple of alignment.
+#define ALIGN(offset, alignment) (((offset) + (alignment) - 1) / (alignment) * (alignment))
+
+GenotypeCache* open_genotype_cache(char* file_name) {
+
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat fileInfo;
+    GenotypeCacheHeader header;
+    if (fstat(fd, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode) || fileInfo.st_size < sizeof(GenotypeCacheHeader) || read(fd, &header, sizeof(GenotypeCacheHeader)) != sizeof(GenotypeCacheHeader)
+        || memcmp(header.magic, GENOTYPE_CACHE_MAGIC, 4) != 0 || header.version != GENOTYPE_CACHE_VERSION || header.byteOrder != GENOTYPE_CACHE_BYTE_ORDER) {
+        close(fd);
+        return NULL;
+    }
+    // The columns must lie in the file.
+    if (header.genotypesOffset + header.numLoci * header.numSamples > fileInfo.st_size || header.positionsOffset + header.numLoci * sizeof(int) > fileInfo.st_size
+        || header.allelesOffset + header.numLoci > fileInfo.st_size || header.chromosomesOffset + header.numChromosomes * sizeof(CacheChromosome) > fileInfo.st_size
+        || header.sampleNamesOffset > fileInfo.st_size || header.chromosomeNamesOffset > fileInfo.st_size) {
+        fprintf(stderr, "%s is a truncated genotype cache.\n", file_name);
+        close(fd);
+        return NULL;
+    }
+    char* map = (char*) mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    madvise(map, fileInfo.st_size, MADV_SEQUENTIAL);
+
+    GenotypeCache* cache = (GenotypeCache*) calloc(1, sizeof(GenotypeCache));
+    cache -> map = map;
+    cache -> mapLength = fileInfo.st_size;
+    cache -> header = (GenotypeCacheHeader*) map;
+    cache -> sampleNames = map + header.sampleNamesOffset;
+    cache -> genotypes = map + header.genotypesOffset;
+    cache -> positions = (int*) (map + header.positionsOffset);
+    cache -> numAlleles = (unsigned char*) (map + header.allelesOffset);
+    cache -> chromosomes = (CacheChromosome*) (map + header.chromosomesOffset);
+    cache -> chromosomeNames = map + header.chromosomeNamesOffset;
+    return cache;
+
+}
+
+CacheChromosome* find_cache_chromosome(GenotypeCache* cache, unsigned long long locus) {
+    // Binary search for the last run starting at or before the locus.
+    unsigned long long low = 0, high = cache -> header -> numChromosomes;
+    while (high - low > 1) {
+        unsigned long long mid = (low + high) / 2;
+        if (cache -> chromosomes[mid].firstLocus <= locus)
+            low = mid;
+        else
+            high = mid;
+    }
+    return &(cache -> chromosomes[low]);
+}
+
+// Writes bytes to the cache and pads the file to an alignment.
+// Accepts:
+//  FILE* out -> The cache file.
+//  void* bytes -> The bytes to write.
+//  size_t length -> The number of bytes.
+//  unsigned long long* offset -> The current offset of the file. Set to the offset of the written bytes.
+//  int alignment -> The alignment of the written bytes.
+// Returns:
+//  bool, False if the write failed.
+static bool write_column(FILE* out, void* bytes, size_t length, unsigned long long* offset, int alignment) {
+    static const char padding[GENOTYPE_CACHE_ALIGNMENT] = { 0 };
+    unsigned long long aligned = ALIGN(*offset, alignment);
+    if (fwrite(padding, 1, aligned - *offset, out) != aligned - *offset || fwrite(bytes, 1, length, out) != length)
+        return false;
+    *offset = aligned;
+    return true;
+}
+
+bool write_genotype_cache(char* vcf_file_name, char* cache_file_name, int numThreads) {
+
+    VCFGenotypeParser* parser = init_vcf_genotype_parser(vcf_file_name, numThreads);
+    if (parser == NULL)
+        return false;
+    FILE* out = fopen(cache_file_name, "wb");
+    if (out == NULL) {
+        destroy_vcf_genotype_parser(parser);
+        return false;
+    }
+
+    GenotypeCacheHeader header;
+    memset(&header, 0, sizeof(GenotypeCacheHeader));
+    memcpy(header.magic, GENOTYPE_CACHE_MAGIC, 4);
+    header.version = GENOTYPE_CACHE_VERSION;
+    header.byteOrder = GENOTYPE_CACHE_BYTE_ORDER;
+    header.numSamples = parser -> num_samples;
+
+    // The header is rewritten once the offsets are known.
+    bool isWritten = fwrite(&header, sizeof(GenotypeCacheHeader), 1, out) == 1;
+    unsigned long long offset = sizeof(GenotypeCacheHeader);
+
+    // Write sample names.
+    kstring_t sampleNames = { 0, 0, NULL };
+    for (int i = 0; i < parser -> num_samples; i++)
+        kputsn(ks_str(&(parser -> sample_names[i])), ks_len(&(parser -> sample_names[i])) + 1, &sampleNames);
+    isWritten = isWritten && write_column(out, ks_str(&sampleNames), ks_len(&sampleNames), &offset, 1);
+    header.sampleNamesOffset = offset;
+    offset += ks_len(&sampleNames);
+    free(ks_str(&sampleNames));
+
+    // The genotype rows are streamed. The other columns are small, so they are kept in memory.
+    int maxLoci = 1024, maxChromosomes = 16;
+    int* positions = (int*) malloc(maxLoci * sizeof(int));
+    unsigned char* numAlleles = (unsigned char*) malloc(maxLoci);
+    CacheChromosome* chromosomes = (CacheChromosome*) malloc(maxChromosomes * sizeof(CacheChromosome));
+    kstring_t chromosomeNames = { 0, 0, NULL };
+    kstring_t* chromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
+    GENOTYPE* genotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    int position, alleles;
+
+    // Genotype rows start on a cache line.
+    isWritten = isWritten && write_column(out, NULL, 0, &offset, GENOTYPE_CACHE_ALIGNMENT);
+    header.genotypesOffset = offset;
+    while (isWritten && !(parser -> isEOF)) {
+        get_next_locus(parser, chromosome, &position, &alleles, &genotypes);
+        if (header.numLoci == maxLoci) {
+            maxLoci *= 2;
+            positions = (int*) realloc(positions, maxLoci * sizeof(int));
+            numAlleles = (unsigned char*) realloc(numAlleles, maxLoci);
+        }
+        positions[header.numLoci] = position;
+        numAlleles[header.numLoci] = alleles;
+        // Start a new run when the chromosome changes.
+        CacheChromosome* last = header.numChromosomes > 0 ? &(chromosomes[header.numChromosomes - 1]) : NULL;
+        if (last == NULL || last -> nameLength != ks_len(chromosome) || strncmp(ks_str(&chromosomeNames) + last -> nameOffset, ks_str(chromosome), ks_len(chromosome)) != 0) {
+            if (header.numChromosomes == maxChromosomes) {
+                maxChromosomes *= 2;
+                chromosomes = (CacheChromosome*) realloc(chromosomes, maxChromosomes * sizeof(CacheChromosome));
+            }
+            last = &(chromosomes[header.numChromosomes++]);
+            last -> firstLocus = header.numLoci;
+            last -> numLoci = 0;
+            last -> nameOffset = ks_len(&chromosomeNames);
+            last -> nameLength = ks_len(chromosome);
+            kputsn(ks_str(chromosome), ks_len(chromosome) + 1, &chromosomeNames);
+        }
+        last -> numLoci++;
+        isWritten = fwrite(genotypes, 1, parser -> num_samples, out) == parser -> num_samples;
+        header.numLoci++;
+    }
+    offset += header.numLoci * parser -> num_samples;
+
+    // Write the remaining columns.
+    isWritten = isWritten && write_column(out, positions, header.numLoci * sizeof(int), &offset, sizeof(int));
+    header.positionsOffset = offset;
+    offset += header.numLoci * sizeof(int);
+    isWritten = isWritten && write_column(out, numAlleles, header.numLoci, &offset, 1);
+    header.allelesOffset = offset;
+    offset += header.numLoci;
+    isWritten = isWritten && write_column(out, chromosomes, header.numChromosomes * sizeof(CacheChromosome), &offset, sizeof(unsigned long long));
+    header.chromosomesOffset = offset;
+    offset += header.numChromosomes * sizeof(CacheChromosome);
+    isWritten = isWritten && write_column(out, ks_str(&chromosomeNames), ks_len(&chromosomeNames), &offset, 1);
+    header.chromosomeNamesOffset = offset;
+
+    // Rewrite the header with the offsets.
+    isWritten = isWritten && fseek(out, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(GenotypeCacheHeader), 1, out) == 1;
+    isWritten = fclose(out) == 0 && isWritten;
+
+    free(positions);
+    free(numAlleles);
+    free(chromosomes);
+    free(ks_str(&chromosomeNames));
+    free(ks_str(chromosome)); free(chromosome);
+    free(genotypes);
+    destroy_vcf_genotype_parser(parser);
+
+    // Do not leave a partial cache behind.
+    if (!isWritten)
+        remove(cache_file_name);
+    return isWritten;
+
+}
+
+void close_genotype_cache(GenotypeCache* cache) {
+    if (cache == NULL)
+        return;
+    munmap(cache -> map, cache -> mapLength);
+    free(cache);
+}
@@ -0,0 +1,103 @@
+// File: GenotypeCache.h
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: A binary, columnar copy of the genotypes in a VCF file for repeated scans.
+
+#ifndef _GENOTYPE_CACHE_
+#define _GENOTYPE_CACHE_
+
+#include <stdlib.h>
+
+#include <stdbool.h>
+
+// Identifies a cache file.
+#define GENOTYPE_CACHE_MAGIC "SWGC"
+
+// Incremented when the layout changes.
+#define GENOTYPE_CACHE_VERSION 1
+
+// Written in native byte order. Used to reject files written on a machine of a different byte order.
+#define GENOTYPE_CACHE_BYTE_ORDER 0x01020304
+
+// Genotype rows start on a cache line.
+#define GENOTYPE_CACHE_ALIGNMENT 64
+
+// The header at the start of the file. The columns follow at the given offsets:
+//  the sample names, one GENOTYPE row of numSamples bytes per locus, the position
+//  of each locus, the number of alleles at each locus, and the chromosome dictionary.
+typedef struct {
+    char magic[4];
+    unsigned int version;
+    unsigned int byteOrder;
+    unsigned int numSamples;
+    unsigned long long numLoci;
+    unsigned long long numChromosomes;
+    // NUL terminated names in sample order.
+    unsigned long long sampleNamesOffset;
+    unsigned long long genotypesOffset;
+    // Positions are 32-bit integers.
+    unsigned long long positionsOffset;
+    // Allele counts are bytes.
+    unsigned long long allelesOffset;
+    unsigned long long chromosomesOffset;
+    // The string table holding the chromosome names.
+    unsigned long long chromosomeNamesOffset;
+} GenotypeCacheHeader;
+
+// A run of consecutive loci on a chromosome. A chromosome split across the VCF file has
+//  more than one run.
+typedef struct {
+    // The index of the first locus in the run.
+    unsigned long long firstLocus;
+    // The number of loci in the run.
+    unsigned long long numLoci;
+    // The name of the chromosome in the string table.
+    unsigned long long nameOffset;
+    unsigned long long nameLength;
+} CacheChromosome;
+
+// An open cache. The columns point into the mapped file.
+typedef struct {
+    char* map;
+    size_t mapLength;
+    GenotypeCacheHeader* header;
+    char* sampleNames;
+    char* genotypes;
+    int* positions;
+    unsigned char* numAlleles;
+    CacheChromosome* chromosomes;
+    char* chromosomeNames;
+} GenotypeCache;
+
+// Maps a cache file and checks its header.
+// Accepts:
+//  char* file_name -> The name of the file.
+// Returns:
+//  GenotypeCache*, The cache, or NULL if the file does not exist or is not a cache.
+GenotypeCache* open_genotype_cache(char* file_name);
+
+// Finds the run holding a locus.
+// Accepts:
+//  GenotypeCache* cache -> The cache.
+//  unsigned long long locus -> The index of the locus.
+// Returns:
+//  CacheChromosome*, The run.
+CacheChromosome* find_cache_chromosome(GenotypeCache* cache, unsigned long long locus);
+
+// Converts a VCF file into a cache. Done once, so later scans skip decompression and parsing.
+// Accepts:
+//  char* vcf_file_name -> The VCF file to read.
+//  char* cache_file_name -> The cache file to write.
+//  int numThreads -> The number of threads used to inflate BGZF blocks.
+// Returns:
+//  bool, False if the VCF file could not be read or the cache could not be written.
+bool write_genotype_cache(char* vcf_file_name, char* cache_file_name, int numThreads);
+
+// Unmaps a cache.
+// Accepts:
+//  GenotypeCache* cache -> The cache to close.
+// Returns:
+//  void.
+void close_genotype_cache(GenotypeCache* cache);
+
+#endif
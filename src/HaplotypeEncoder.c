@@ -4,13 +4,30 @@
 // Author: TQ Smith
 // Purpose: Track the haplotypes of each sample using a simplified arithmetic encoding.
 
+#include <string.h>
+
+#include <unistd.h>
+
+#include <limits.h>
+
+#include <sched.h>
+
 #include "HaplotypeEncoder.h"
 
+#include "Instrumentation.h"
+
+// AVX2 kernels are compiled for the target and only called when the CPU supports them.
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define USE_AVX2
+#endif
+
 // Macros to get the left and right allele from the 1-byte encoding.
-#define LEFT_ALLELE(a) (a >> 4)
-#define RIGHT_ALLELE(a) (a & 0x0F)
+//  GENOTYPE is signed, so shift it as unsigned to keep alleles past 7 positive.
+#define LEFT_ALLELE(a) ((unsigned char) (a) >> 4)
+#define RIGHT_ALLELE(a) ((unsigned char) (a) & 0x0F)
 
-HaplotypeEncoder* init_haplotype_encoder(int numSamples) {
+HaplotypeEncoder* init_haplotype_encoder(int numSamples, bool isWide) {
 
     // Allocate the structure's memory.
     HaplotypeEncoder* encoder = (HaplotypeEncoder*) calloc(1, sizeof(HaplotypeEncoder));
@@ -24,41 +41,33 @@ HaplotypeEncoder* init_haplotype_encoder(int numSamples) {
     // Allocate string to hold chromosome.
     encoder -> chromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
 
-    // Create the hash table used for relabeling.
-    encoder -> labelMap = kh_init(32);
-    
+    // Allocate the list of filled slots used by relabeling.
+    encoder -> probeSlots = (unsigned int*) malloc(2 * numSamples * sizeof(unsigned int));
+
+    // Allocate the 64-bit encodings.
+    encoder -> isWide = isWide;
+    if (isWide) {
+        encoder -> leftWideHaplotype = (unsigned long long*) calloc(numSamples, sizeof(unsigned long long));
+        encoder -> rightWideHaplotype = (unsigned long long*) calloc(numSamples, sizeof(unsigned long long));
+    }
+
     // The tree starts off with one leaf, the empty string.
     encoder -> numLeaves = 1;
+    encoder -> numWideLeaves = 1;
 
     // Return the encoder.
     return encoder;
 
 }
 
-void add_locus(HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGenotypes) {
-    
-    // Iterate through the samples.
-    for (int i = 0; i < encoder -> numSamples; i++) {
-        // Haplotypes get the allele genotypes at the first level.
-        if (encoder -> numLeaves == 1) {
-            encoder -> leftHaplotype[i] = LEFT_ALLELE(encoder -> genotypes[i]);
-            encoder -> rightHaplotype[i] = RIGHT_ALLELE(encoder -> genotypes[i]);
-            // If we are collapsing missing genotypes, and either allele is missing, move both to the right most leaf.
-            if (collapseMissingGenotypes && (encoder -> leftHaplotype[i] == numAlleles || encoder -> rightHaplotype[i] == numAlleles)) {
-                encoder -> leftHaplotype[i] = numAlleles;
-                encoder -> rightHaplotype[i] = numAlleles;
-            }
-        // If we are collapsing genotypes and a missing genotype is encountered, move each to the left most leaf.
-        } else if (collapseMissingGenotypes && (encoder -> leftHaplotype[i] == (encoder -> numLeaves - 1) || encoder -> rightHaplotype[i] == (encoder -> numLeaves - 1) || LEFT_ALLELE(encoder -> genotypes[i]) == numAlleles || RIGHT_ALLELE(encoder -> genotypes[i]) == numAlleles)) {
-            encoder -> leftHaplotype[i] = encoder -> numLeaves * (numAlleles + 1) - 1;
-            encoder -> rightHaplotype[i] = encoder -> numLeaves * (numAlleles + 1) - 1;
-        // Otherwise, advance haplotypes to the next level.
-        } else {
-            encoder -> leftHaplotype[i] = encoder -> leftHaplotype[i] * (numAlleles + 1) + LEFT_ALLELE(encoder -> genotypes[i]);
-            encoder -> rightHaplotype[i] = encoder -> rightHaplotype[i] * (numAlleles + 1) + RIGHT_ALLELE(encoder -> genotypes[i]);
-        }
-    }
-    
+// Extends the tree by a locus and relabels it if it grew too large.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int numAlleles -> The number of alleles at the locus.
+// Returns:
+//  void.
+static void extend_tree(HaplotypeEncoder* encoder, int numAlleles) {
+
     // Extend tree.
     encoder -> numLeaves = (encoder -> numLeaves) * (numAlleles + 1);
 
@@ -69,70 +78,806 @@ void add_locus(HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGe
 
 }
 
-void relabel_haplotypes(HaplotypeEncoder* encoder) {
+// Adds a locus to the haplotypes of samples start ... end - 1.
+//  The per-locus branches are hoisted out of the loop over samples.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int start -> The first sample.
+//  int end -> One past the last sample.
+//  int numAlleles -> The number of alleles at the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+static void add_locus_scalar(HaplotypeEncoder* encoder, int start, int end, int numAlleles, bool collapseMissingGenotypes) {
+
+    GENOTYPE* genotypes = encoder -> genotypes;
+    unsigned int* left = encoder -> leftHaplotype;
+    unsigned int* right = encoder -> rightHaplotype;
+
+    // Haplotypes get the allele genotypes at the first level. Tested by the number of loci,
+    //  since a tree relabeled to a single leaf holds samples collapsed to the missing leaf.
+    if (encoder -> numLoci == 0) {
+        for (int i = start; i < end; i++) {
+            left[i] = LEFT_ALLELE(genotypes[i]);
+            right[i] = RIGHT_ALLELE(genotypes[i]);
+            // If we are collapsing missing genotypes, and either allele is missing, move both to the right most leaf.
+            if (collapseMissingGenotypes && (left[i] == numAlleles || right[i] == numAlleles)) {
+                left[i] = numAlleles;
+                right[i] = numAlleles;
+            }
+        }
+    // If we are collapsing genotypes and a missing genotype is encountered, move each to the right most leaf.
+    } else if (collapseMissingGenotypes) {
+        unsigned int missingLeaf = encoder -> numLeaves - 1, collapsedLeaf = encoder -> numLeaves * (numAlleles + 1) - 1;
+        for (int i = start; i < end; i++) {
+            if (left[i] == missingLeaf || right[i] == missingLeaf || LEFT_ALLELE(genotypes[i]) == numAlleles || RIGHT_ALLELE(genotypes[i]) == numAlleles) {
+                left[i] = collapsedLeaf;
+                right[i] = collapsedLeaf;
+            } else {
+                left[i] = left[i] * (numAlleles + 1) + LEFT_ALLELE(genotypes[i]);
+                right[i] = right[i] * (numAlleles + 1) + RIGHT_ALLELE(genotypes[i]);
+            }
+        }
+    // Otherwise, advance haplotypes to the next level.
+    } else {
+        for (int i = start; i < end; i++) {
+            left[i] = left[i] * (numAlleles + 1) + LEFT_ALLELE(genotypes[i]);
+            right[i] = right[i] * (numAlleles + 1) + RIGHT_ALLELE(genotypes[i]);
+        }
+    }
 
-    // Clear hash table of any contents without deallocating memory.
-    kh_clear(32, encoder -> labelMap);
-    
-    // Track the new label.
-    int ret, newLabel = 0;
+}
 
-    // Map the right most leaf to 0xFFFFFFFF.
-    khiter_t k = kh_put(32, encoder -> labelMap, encoder -> numLeaves - 1, &ret);
-    kh_value(encoder -> labelMap, k) = 0xFFFFFFFF;
+#ifdef USE_AVX2
+// Adds a locus to the haplotypes of eight samples at a time. Missing genotypes are
+//  collapsed with a blend instead of a branch. See add_locus_scalar.
+// Returns:
+//  int, One past the last sample processed. The rest are left to the caller.
+__attribute__((target("avx2")))
+static int add_locus_avx2(HaplotypeEncoder* encoder, int start, int end, int numAlleles, bool collapseMissingGenotypes) {
+
+    const __m256i lowNibble = _mm256_set1_epi32(0x0F);
+    const __m256i base = _mm256_set1_epi32(numAlleles + 1);
+    const __m256i missingAllele = _mm256_set1_epi32(numAlleles);
+    const __m256i missingLeaf = _mm256_set1_epi32(encoder -> numLeaves - 1);
+    const __m256i collapsedLeaf = _mm256_set1_epi32(encoder -> numLeaves * (numAlleles + 1) - 1);
+    // At the first level, the haplotypes are zero, so the multiply-add leaves just the alleles.
+    const __m256i isFirstLevel = _mm256_set1_epi32(encoder -> numLoci == 0 ? -1 : 0);
+    const __m256i isCollapsing = _mm256_set1_epi32(collapseMissingGenotypes ? -1 : 0);
+
+    int i = start;
+    for (; i + 8 <= end; i += 8) {
+        // Zero extend, so alleles past 7 stay positive as in LEFT_ALLELE.
+        __m256i genotypes = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i*) (encoder -> genotypes + i)));
+        __m256i leftAllele = _mm256_srli_epi32(genotypes, 4);
+        __m256i rightAllele = _mm256_and_si256(genotypes, lowNibble);
+        __m256i left = _mm256_andnot_si256(isFirstLevel, _mm256_loadu_si256((__m256i*) (encoder -> leftHaplotype + i)));
+        __m256i right = _mm256_andnot_si256(isFirstLevel, _mm256_loadu_si256((__m256i*) (encoder -> rightHaplotype + i)));
+
+        // Samples with a missing allele, or a haplotype already on the missing leaf.
+        __m256i isMissing = _mm256_or_si256(_mm256_cmpeq_epi32(leftAllele, missingAllele), _mm256_cmpeq_epi32(rightAllele, missingAllele));
+        isMissing = _mm256_or_si256(isMissing, _mm256_andnot_si256(isFirstLevel, _mm256_or_si256(_mm256_cmpeq_epi32(left, missingLeaf), _mm256_cmpeq_epi32(right, missingLeaf))));
+        isMissing = _mm256_and_si256(isMissing, isCollapsing);
+
+        left = _mm256_add_epi32(_mm256_mullo_epi32(left, base), leftAllele);
+        right = _mm256_add_epi32(_mm256_mullo_epi32(right, base), rightAllele);
+        _mm256_storeu_si256((__m256i*) (encoder -> leftHaplotype + i), _mm256_blendv_epi8(left, collapsedLeaf, isMissing));
+        _mm256_storeu_si256((__m256i*) (encoder -> rightHaplotype + i), _mm256_blendv_epi8(right, collapsedLeaf, isMissing));
+    }
 
-    for (int i = 0; i < encoder -> numSamples; i++) {
+    return i;
 
-        // If encoded value does not exist in the hash table, map value to new label.
-        if (kh_get(32, encoder -> labelMap, encoder -> leftHaplotype[i]) == kh_end(encoder -> labelMap)) {
-            k = kh_put(32, encoder -> labelMap, encoder -> leftHaplotype[i], &ret);
-            kh_value(encoder -> labelMap, k) = newLabel++;
-        }
+}
+#endif
+
+// Checks if the CPU supports AVX2. The first call must not race with others.
+// Accepts:
+//  void.
+// Returns:
+//  bool, True if AVX2 kernels can be called.
+static bool has_avx2() {
+#ifdef USE_AVX2
+    static int hasAVX2 = -1;
+    if (hasAVX2 < 0)
+        hasAVX2 = __builtin_cpu_supports("avx2");
+    return hasAVX2;
+#else
+    return false;
+#endif
+}
+
+// Adds a locus to the haplotypes of samples start ... end - 1. See add_locus_scalar.
+static void add_locus_range(HaplotypeEncoder* encoder, int start, int end, int numAlleles, bool collapseMissingGenotypes) {
+
+    // Process samples in vector blocks when the CPU supports it, and the remainder one at a time.
+    int numProcessed = start;
+#ifdef USE_AVX2
+    if (has_avx2())
+        numProcessed = add_locus_avx2(encoder, start, end, numAlleles, collapseMissingGenotypes);
+#endif
+    add_locus_scalar(encoder, numProcessed, end, numAlleles, collapseMissingGenotypes);
+
+}
+
+static void run_shard_task(HaplotypeEncoder* encoder, SHARD_TASK task);
 
-        // If encoded value does not exist in the hash table, map value to new label.
-        if (kh_get(32, encoder -> labelMap, encoder -> rightHaplotype[i]) == kh_end(encoder -> labelMap)) {
-            k = kh_put(32, encoder -> labelMap, encoder -> rightHaplotype[i], &ret);
-            kh_value(encoder -> labelMap, k) = newLabel++;
+void add_locus(HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGenotypes) {
+
+    if (encoder -> shardPool != NULL) {
+        encoder -> shardPool -> numAlleles = numAlleles;
+        encoder -> shardPool -> collapseMissingGenotypes = collapseMissingGenotypes;
+        run_shard_task(encoder, SHARD_ADD_LOCUS);
+    } else
+        add_locus_range(encoder, 0, encoder -> numSamples, numAlleles, collapseMissingGenotypes);
+
+    extend_tree(encoder, numAlleles);
+
+}
+
+// Adds a biallelic locus to the haplotypes of the samples in words firstWord ... endWord - 1
+//  of the bitplanes. See add_packed_locus.
+static void add_packed_words(HaplotypeEncoder* encoder, PackedGenotypes* packed, int firstWord, int endWord, bool collapseMissingGenotypes) {
+
+    // Biallelic loci have the alleles 0, 1 and the missing allele 2.
+    unsigned int missingLeaf = encoder -> numLeaves - 1, collapsedLeaf = encoder -> numLeaves * 3 - 1;
+
+    // Iterate through the samples 64 at a time.
+    for (int word = firstWord; word < endWord; word++) {
+        unsigned long long leftAlternate = packed -> leftAlternate[word], leftMissing = packed -> leftMissing[word];
+        unsigned long long rightAlternate = packed -> rightAlternate[word], rightMissing = packed -> rightMissing[word];
+        // Samples with either allele missing.
+        unsigned long long missing = collapseMissingGenotypes ? (leftMissing | rightMissing) : 0;
+        unsigned int* left = encoder -> leftHaplotype + 64 * word;
+        unsigned int* right = encoder -> rightHaplotype + 64 * word;
+        int numInWord = encoder -> numSamples - 64 * word < 64 ? encoder -> numSamples - 64 * word : 64;
+
+        // Haplotypes get the allele genotypes at the first level. See add_locus_scalar.
+        if (encoder -> numLoci == 0) {
+            for (int bit = 0; bit < numInWord; bit++) {
+                if ((missing >> bit) & 1) {
+                    left[bit] = 2;
+                    right[bit] = 2;
+                } else {
+                    left[bit] = ((leftAlternate >> bit) & 1) | (((leftMissing >> bit) & 1) << 1);
+                    right[bit] = ((rightAlternate >> bit) & 1) | (((rightMissing >> bit) & 1) << 1);
+                }
+            }
+        // If no haplotype can be collapsed, only advance haplotypes to the next level.
+        } else if (!collapseMissingGenotypes) {
+            for (int bit = 0; bit < numInWord; bit++) {
+                left[bit] = left[bit] * 3 + (((leftAlternate >> bit) & 1) | (((leftMissing >> bit) & 1) << 1));
+                right[bit] = right[bit] * 3 + (((rightAlternate >> bit) & 1) | (((rightMissing >> bit) & 1) << 1));
+            }
+        // Otherwise, move missing genotypes to the right most leaf and advance the rest.
+        } else {
+            for (int bit = 0; bit < numInWord; bit++) {
+                if (((missing >> bit) & 1) || left[bit] == missingLeaf || right[bit] == missingLeaf) {
+                    left[bit] = collapsedLeaf;
+                    right[bit] = collapsedLeaf;
+                } else {
+                    left[bit] = left[bit] * 3 + ((leftAlternate >> bit) & 1);
+                    right[bit] = right[bit] * 3 + ((rightAlternate >> bit) & 1);
+                }
+            }
         }
-        
-        // Relabel haplotypes.
-        encoder -> leftHaplotype[i] = kh_value(encoder -> labelMap, kh_get(32, encoder -> labelMap, encoder -> leftHaplotype[i]));
-        encoder -> rightHaplotype[i] = kh_value(encoder -> labelMap, kh_get(32, encoder -> labelMap, encoder -> rightHaplotype[i]));
+    }
+
+}
+
+void add_packed_locus(HaplotypeEncoder* encoder, PackedGenotypes* packed, bool collapseMissingGenotypes) {
+
+    if (encoder -> shardPool != NULL) {
+        encoder -> shardPool -> packed = packed;
+        encoder -> shardPool -> collapseMissingGenotypes = collapseMissingGenotypes;
+        run_shard_task(encoder, SHARD_ADD_PACKED_LOCUS);
+    } else
+        add_packed_words(encoder, packed, 0, packed -> numWords, collapseMissingGenotypes);
+
+    extend_tree(encoder, 2);
+
+}
+
+// Relabels haplotype encodings with a table indexed by encoding. Used when the tree is
+//  not much larger than the number of haplotypes.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder to simplify.
+// Returns:
+//  bool, False if an encoding is outside the tree. The haplotypes are left unchanged.
+static bool relabel_haplotypes_dense(HaplotypeEncoder* encoder) {
+
+    // Grow the table if needed and mark every leaf as unlabeled.
+    if (encoder -> labelTableSize < encoder -> numLeaves) {
+        encoder -> labelTableSize = encoder -> numLeaves;
+        encoder -> labelTable = (int*) realloc(encoder -> labelTable, encoder -> labelTableSize * sizeof(int));
+    }
+    memset(encoder -> labelTable, 0xFF, encoder -> numLeaves * sizeof(int));
+
+    // The right most leaf is labeled last.
+    unsigned int missingLeaf = encoder -> numLeaves - 1;
+    int newLabel = 0;
+
+    // Label encodings in the order they are first seen. Stop before indexing past the table.
+    for (int i = 0; i < encoder -> numSamples; i++) {
+        unsigned int left = encoder -> leftHaplotype[i], right = encoder -> rightHaplotype[i];
+        if (left > missingLeaf || right > missingLeaf)
+            return false;
+        if (left != missingLeaf && encoder -> labelTable[left] < 0)
+            encoder -> labelTable[left] = newLabel++;
+        if (right != missingLeaf && encoder -> labelTable[right] < 0)
+            encoder -> labelTable[right] = newLabel++;
+    }
+    encoder -> labelTable[missingLeaf] = newLabel;
+
+    // Relabel haplotypes.
+    for (int i = 0; i < encoder -> numSamples; i++) {
+        encoder -> leftHaplotype[i] = encoder -> labelTable[encoder -> leftHaplotype[i]];
+        encoder -> rightHaplotype[i] = encoder -> labelTable[encoder -> rightHaplotype[i]];
+    }
+
+    INSTRUMENT_RELABEL(encoder -> numLeaves, newLabel + 1);
+
+    // New number of leaves.
+    encoder -> numLeaves = newLabel + 1;
+
+    return true;
+
+}
+
+// Makes sure an open addressing table has at least twice as many slots as encodings,
+//  so it never fills. New tables are empty.
+// Accepts:
+//  ProbeEntry** table -> The table. Replaced if it is too small.
+//  int* tableSize -> The number of slots in the table, a power of two.
+//  int numEncodings -> The most encodings the table will hold.
+// Returns:
+//  void.
+static void grow_probe_table(ProbeEntry** table, int* tableSize, int numEncodings) {
+    if (*tableSize >= 2 * numEncodings)
+        return;
+    *tableSize = 1;
+    while (*tableSize < 2 * numEncodings)
+        *tableSize <<= 1;
+    free(*table);
+    *table = (ProbeEntry*) malloc(*tableSize * sizeof(ProbeEntry));
+    memset(*table, 0xFF, *tableSize * sizeof(ProbeEntry));
+}
 
+// Finds the slot of an encoding, or the empty slot to put it in.
+// Accepts:
+//  ProbeEntry* table -> The table.
+//  unsigned int mask -> The number of slots minus one.
+//  unsigned int encoding -> The encoding.
+// Returns:
+//  unsigned int, The slot.
+static inline unsigned int find_probe_slot(ProbeEntry* table, unsigned int mask, unsigned int encoding) {
+    unsigned int slot = (encoding * 2654435761U) & mask;
+    while (table[slot].encoding != EMPTY_ENCODING && table[slot].encoding != encoding)
+        slot = (slot + 1) & mask;
+    return slot;
+}
+
+// Relabels haplotype encodings with an open addressing table that looks up
+//  each haplotype once. Only the slots that were filled are cleared afterwards.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder to simplify.
+// Returns:
+//  void.
+static void relabel_haplotypes_probe(HaplotypeEncoder* encoder) {
+
+    // The table has at least twice as many slots as haplotypes, so it never fills.
+    int numHaplotypes = 2 * encoder -> numSamples;
+    grow_probe_table(&(encoder -> probeTable), &(encoder -> probeTableSize), numHaplotypes);
+    unsigned int mask = encoder -> probeTableSize - 1;
+    ProbeEntry* table = encoder -> probeTable;
+
+    // The right most leaf is labeled last.
+    unsigned int missingLeaf = encoder -> numLeaves - 1;
+    int newLabel = 0;
+
+    for (int i = 0; i < numHaplotypes; i++) {
+        unsigned int* haplotype = (i & 1) ? &(encoder -> rightHaplotype[i >> 1]) : &(encoder -> leftHaplotype[i >> 1]);
+        if (*haplotype == missingLeaf) {
+            // Assigned after all labels are known.
+            *haplotype = EMPTY_ENCODING;
+            continue;
+        }
+        // Find the encoding's slot, or the empty slot to put it in.
+        unsigned int slot = find_probe_slot(table, mask, *haplotype);
+        if (table[slot].encoding == EMPTY_ENCODING) {
+            table[slot].encoding = *haplotype;
+            table[slot].label = newLabel;
+            encoder -> probeSlots[newLabel++] = slot;
+        }
+        *haplotype = table[slot].label;
     }
 
+    // Empty the slots that were filled.
+    for (int i = 0; i < newLabel; i++)
+        table[encoder -> probeSlots[i]].encoding = EMPTY_ENCODING;
+
     // For all of the haplotypes labeled with the right-most leaf of old tree, assign right-most label of new tree.
     for (int i = 0; i < encoder -> numSamples; i++) {
-        if (encoder -> leftHaplotype[i] == 0xFFFFFFFF)
+        if (encoder -> leftHaplotype[i] == EMPTY_ENCODING)
             encoder -> leftHaplotype[i] = newLabel;
-        if (encoder -> rightHaplotype[i] == 0xFFFFFFFF)
+        if (encoder -> rightHaplotype[i] == EMPTY_ENCODING)
             encoder -> rightHaplotype[i] = newLabel;
     }
 
+    INSTRUMENT_RELABEL(encoder -> numLeaves, newLabel + 1);
+
     // New number of leaves.
     encoder -> numLeaves = newLabel + 1;
 
 }
 
-bool get_next_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int HAP_SIZE) {
+// Replaces each encoding of a shard with its index among the shard's distinct encodings,
+//  in the order they are first seen. Haplotypes on the missing leaf are marked empty.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  EncoderShard* shard -> The shard.
+//  unsigned int missingLeaf -> The right most leaf of the tree.
+// Returns:
+//  void.
+static void find_distinct_in_shard(HaplotypeEncoder* encoder, EncoderShard* shard, unsigned int missingLeaf) {
+    unsigned int mask = shard -> probeTableSize - 1;
+    ProbeEntry* table = shard -> probeTable;
+    int numDistinct = 0;
+    for (int i = 2 * shard -> start; i < 2 * shard -> end; i++) {
+        unsigned int* haplotype = (i & 1) ? &(encoder -> rightHaplotype[i >> 1]) : &(encoder -> leftHaplotype[i >> 1]);
+        if (*haplotype == missingLeaf) {
+            *haplotype = EMPTY_ENCODING;
+            continue;
+        }
+        unsigned int slot = find_probe_slot(table, mask, *haplotype);
+        if (table[slot].encoding == EMPTY_ENCODING) {
+            table[slot].encoding = *haplotype;
+            table[slot].label = numDistinct;
+            shard -> probeSlots[numDistinct++] = slot;
+        }
+        *haplotype = table[slot].label;
+    }
+    shard -> numDistinct = numDistinct;
+}
 
-    // If EOF, there is no next haplotype.
-    if (parser -> isEOF)
-        return false;
-    
-    // Set chromosome of next record from parser.
-    encoder -> chromosome -> l = 0;
-    kputs(ks_str(parser -> nextChromosome), encoder -> chromosome);
+// Replaces each index in a shard with its label, and empties the shard's table.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  EncoderShard* shard -> The shard.
+//  unsigned int missingLabel -> The label of haplotypes on the missing leaf.
+// Returns:
+//  void.
+static void apply_labels_to_shard(HaplotypeEncoder* encoder, EncoderShard* shard, unsigned int missingLabel) {
+    for (int i = shard -> start; i < shard -> end; i++) {
+        encoder -> leftHaplotype[i] = encoder -> leftHaplotype[i] == EMPTY_ENCODING ? missingLabel : shard -> labels[encoder -> leftHaplotype[i]];
+        encoder -> rightHaplotype[i] = encoder -> rightHaplotype[i] == EMPTY_ENCODING ? missingLabel : shard -> labels[encoder -> rightHaplotype[i]];
+    }
+    for (int i = 0; i < shard -> numDistinct; i++)
+        shard -> probeTable[shard -> probeSlots[i]].encoding = EMPTY_ENCODING;
+}
+
+// Claims shards and runs the pool's task on them until none are left.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+// Returns:
+//  void.
+static void run_shards(HaplotypeEncoder* encoder) {
+    ShardPool* pool = encoder -> shardPool;
+    int next;
+    // Claiming a shard acquires the task's arguments.
+    while ((next = __atomic_fetch_add(&(pool -> nextShard), 1, __ATOMIC_ACQ_REL)) < pool -> numShards) {
+        EncoderShard* shard = &(pool -> shards[next]);
+        switch (pool -> task) {
+            case SHARD_ADD_LOCUS:
+                add_locus_range(encoder, shard -> start, shard -> end, pool -> numAlleles, pool -> collapseMissingGenotypes);
+                break;
+            case SHARD_ADD_PACKED_LOCUS:
+                add_packed_words(encoder, pool -> packed, shard -> start / 64, (shard -> end + 63) / 64, pool -> collapseMissingGenotypes);
+                break;
+            case SHARD_FIND_DISTINCT:
+                find_distinct_in_shard(encoder, shard, pool -> missingLeaf);
+                break;
+            case SHARD_APPLY_LABELS:
+                apply_labels_to_shard(encoder, shard, pool -> missingLabel);
+                break;
+        }
+        __atomic_fetch_add(&(pool -> numDone), 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Waits briefly for a shard task. Spins, then gives up the core.
+// Accepts:
+//  int* spins -> The number of times the caller has waited.
+// Returns:
+//  void.
+static void wait_on_shards(int* spins) {
+    if ((*spins)++ < 64) {
+#ifdef USE_AVX2
+        _mm_pause();
+#endif
+    } else
+        sched_yield();
+}
+
+// The routine run by each thread of the pool. Waits for a task, then works on its shards.
+// Accepts:
+//  void* arg -> The encoder.
+// Returns:
+//  void*, Always NULL.
+static void* encode_shards(void* arg) {
+    HaplotypeEncoder* encoder = (HaplotypeEncoder*) arg;
+    ShardPool* pool = encoder -> shardPool;
+    unsigned int generation = 0;
+    while (true) {
+        // Spin for the next task. Loci usually arrive quickly, but sleep once they stop.
+        int spins = 0;
+        while (__atomic_load_n(&(pool -> generation), __ATOMIC_ACQUIRE) == generation && !__atomic_load_n(&(pool -> isShutdown), __ATOMIC_ACQUIRE) && spins < SHARD_SPINS)
+            wait_on_shards(&spins);
+        if (spins == SHARD_SPINS) {
+            pthread_mutex_lock(&(pool -> lock));
+            __atomic_fetch_add(&(pool -> numSleeping), 1, __ATOMIC_SEQ_CST);
+            while (__atomic_load_n(&(pool -> generation), __ATOMIC_SEQ_CST) == generation && !(pool -> isShutdown))
+                pthread_cond_wait(&(pool -> taskStarted), &(pool -> lock));
+            __atomic_fetch_sub(&(pool -> numSleeping), 1, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&(pool -> lock));
+        }
+        if (__atomic_load_n(&(pool -> isShutdown), __ATOMIC_ACQUIRE))
+            break;
+        generation = __atomic_load_n(&(pool -> generation), __ATOMIC_ACQUIRE);
+        run_shards(encoder);
+    }
+    return NULL;
+}
+
+// Runs a task on every shard and returns once they are done. The task's arguments
+//  must be set in the pool.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  SHARD_TASK task -> The task.
+// Returns:
+//  void.
+static void run_shard_task(HaplotypeEncoder* encoder, SHARD_TASK task) {
+    ShardPool* pool = encoder -> shardPool;
+    pool -> task = task;
+    pool -> numDone = 0;
+    __atomic_store_n(&(pool -> nextShard), 0, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&(pool -> generation), 1, __ATOMIC_SEQ_CST);
+    // Wake the threads that went to sleep.
+    if (__atomic_load_n(&(pool -> numSleeping), __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&(pool -> lock));
+        pthread_cond_broadcast(&(pool -> taskStarted));
+        pthread_mutex_unlock(&(pool -> lock));
+    }
+    run_shards(encoder);
+    int spins = 0;
+    while (__atomic_load_n(&(pool -> numDone), __ATOMIC_ACQUIRE) < pool -> numShards)
+        wait_on_shards(&spins);
+}
+
+// Relabels the haplotypes shard by shard. Each shard finds its distinct encodings in
+//  parallel. Then the distinct encodings are labeled shard by shard, in the order they
+//  were first seen, which is the order a single thread would label them in.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder to simplify.
+// Returns:
+//  void.
+static void relabel_haplotypes_sharded(HaplotypeEncoder* encoder) {
+
+    ShardPool* pool = encoder -> shardPool;
+    pool -> missingLeaf = encoder -> numLeaves - 1;
+    run_shard_task(encoder, SHARD_FIND_DISTINCT);
+
+    // Merge the distinct encodings of the shards.
+    grow_probe_table(&(encoder -> probeTable), &(encoder -> probeTableSize), 2 * encoder -> numSamples);
+    unsigned int mask = encoder -> probeTableSize - 1;
+    ProbeEntry* table = encoder -> probeTable;
+    unsigned int newLabel = 0;
+    for (int i = 0; i < pool -> numShards; i++) {
+        EncoderShard* shard = &(pool -> shards[i]);
+        for (int j = 0; j < shard -> numDistinct; j++) {
+            unsigned int encoding = shard -> probeTable[shard -> probeSlots[j]].encoding;
+            unsigned int slot = find_probe_slot(table, mask, encoding);
+            if (table[slot].encoding == EMPTY_ENCODING) {
+                table[slot].encoding = encoding;
+                table[slot].label = newLabel;
+                encoder -> probeSlots[newLabel++] = slot;
+            }
+            shard -> labels[j] = table[slot].label;
+        }
+    }
+    for (int i = 0; i < newLabel; i++)
+        table[encoder -> probeSlots[i]].encoding = EMPTY_ENCODING;
+
+    // The right most leaf is labeled last.
+    pool -> missingLabel = newLabel;
+    run_shard_task(encoder, SHARD_APPLY_LABELS);
+
+    INSTRUMENT_RELABEL(encoder -> numLeaves, newLabel + 1);
+
+    // New number of leaves.
+    encoder -> numLeaves = newLabel + 1;
+
+}
+
+void enable_sharded_encoding(HaplotypeEncoder* encoder, int numThreads) {
+
+    if (encoder == NULL || encoder -> shardPool != NULL || encoder -> isWide || numThreads < 2 || encoder -> numSamples <= SHARD_SIZE)
+        return;
+
+    // With a single core, the threads would only take turns.
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        return;
+
+    // Detect the kernels before the threads race to.
+    has_avx2();
+
+    ShardPool* pool = (ShardPool*) calloc(1, sizeof(ShardPool));
+    pool -> numShards = (encoder -> numSamples + SHARD_SIZE - 1) / SHARD_SIZE;
+    pool -> shards = (EncoderShard*) calloc(pool -> numShards, sizeof(EncoderShard));
+    for (int i = 0; i < pool -> numShards; i++) {
+        EncoderShard* shard = &(pool -> shards[i]);
+        shard -> start = i * SHARD_SIZE;
+        shard -> end = shard -> start + SHARD_SIZE < encoder -> numSamples ? shard -> start + SHARD_SIZE : encoder -> numSamples;
+        grow_probe_table(&(shard -> probeTable), &(shard -> probeTableSize), 2 * (shard -> end - shard -> start));
+        shard -> probeSlots = (unsigned int*) malloc(2 * (shard -> end - shard -> start) * sizeof(unsigned int));
+        shard -> labels = (unsigned int*) malloc(2 * (shard -> end - shard -> start) * sizeof(unsigned int));
+    }
+    pthread_mutex_init(&(pool -> lock), NULL);
+    pthread_cond_init(&(pool -> taskStarted), NULL);
+
+    // The caller works on the shards too.
+    pool -> numThreads = (numThreads < pool -> numShards ? numThreads : pool -> numShards) - 1;
+    pool -> threads = (pthread_t*) calloc(pool -> numThreads > 0 ? pool -> numThreads : 1, sizeof(pthread_t));
+    encoder -> shardPool = pool;
+    for (int i = 0; i < pool -> numThreads; i++)
+        pthread_create(&(pool -> threads[i]), NULL, encode_shards, encoder);
+
+}
+
+// Stops the threads of a shard pool and frees it.
+// Accepts:
+//  ShardPool* pool -> The pool to destroy.
+// Returns:
+//  void.
+static void destroy_shard_pool(ShardPool* pool) {
+    if (pool == NULL)
+        return;
+    pthread_mutex_lock(&(pool -> lock));
+    __atomic_store_n(&(pool -> isShutdown), true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&(pool -> taskStarted));
+    pthread_mutex_unlock(&(pool -> lock));
+    for (int i = 0; i < pool -> numThreads; i++)
+        pthread_join(pool -> threads[i], NULL);
+    pthread_mutex_destroy(&(pool -> lock));
+    pthread_cond_destroy(&(pool -> taskStarted));
+    for (int i = 0; i < pool -> numShards; i++) {
+        free(pool -> shards[i].probeTable);
+        free(pool -> shards[i].probeSlots);
+        free(pool -> shards[i].labels);
+    }
+    free(pool -> shards);
+    free(pool -> threads);
+    free(pool);
+}
+
+// Adds a locus to the 64-bit haplotypes of each sample. See add_locus_scalar.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int numAlleles -> The number of alleles at the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+static void add_wide_locus(HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGenotypes) {
+
+    GENOTYPE* genotypes = encoder -> genotypes;
+    unsigned long long* left = encoder -> leftWideHaplotype;
+    unsigned long long* right = encoder -> rightWideHaplotype;
+
+    // Haplotypes get the allele genotypes at the first level. See add_locus_scalar.
+    if (encoder -> numLoci == 0) {
+        for (int i = 0; i < encoder -> numSamples; i++) {
+            left[i] = (unsigned int) LEFT_ALLELE(genotypes[i]);
+            right[i] = (unsigned int) RIGHT_ALLELE(genotypes[i]);
+            if (collapseMissingGenotypes && (left[i] == numAlleles || right[i] == numAlleles)) {
+                left[i] = numAlleles;
+                right[i] = numAlleles;
+            }
+        }
+    // If we are collapsing genotypes and a missing genotype is encountered, move each to the right most leaf.
+    } else if (collapseMissingGenotypes) {
+        unsigned long long missingLeaf = encoder -> numWideLeaves - 1, collapsedLeaf = encoder -> numWideLeaves * (numAlleles + 1) - 1;
+        for (int i = 0; i < encoder -> numSamples; i++) {
+            if (left[i] == missingLeaf || right[i] == missingLeaf || LEFT_ALLELE(genotypes[i]) == numAlleles || RIGHT_ALLELE(genotypes[i]) == numAlleles) {
+                left[i] = collapsedLeaf;
+                right[i] = collapsedLeaf;
+            } else {
+                left[i] = left[i] * (numAlleles + 1) + (unsigned int) LEFT_ALLELE(genotypes[i]);
+                right[i] = right[i] * (numAlleles + 1) + (unsigned int) RIGHT_ALLELE(genotypes[i]);
+            }
+        }
+    // Otherwise, advance haplotypes to the next level.
+    } else {
+        for (int i = 0; i < encoder -> numSamples; i++) {
+            left[i] = left[i] * (numAlleles + 1) + (unsigned int) LEFT_ALLELE(genotypes[i]);
+            right[i] = right[i] * (numAlleles + 1) + (unsigned int) RIGHT_ALLELE(genotypes[i]);
+        }
+    }
+
+    // Extend tree.
+    encoder -> numWideLeaves *= numAlleles + 1;
+
+    // Only relabel when the next locus could overflow 64 bits.
+    if (encoder -> numWideLeaves >= MAX_NUM_WIDE_LEAVES)
+        relabel_wide_haplotypes(encoder);
+
+}
+
+void relabel_wide_haplotypes(HaplotypeEncoder* encoder) {
+
+    INSTRUMENT_START(timer);
+
+    // The table has at least twice as many slots as haplotypes, so it never fills.
+    int numHaplotypes = 2 * encoder -> numSamples;
+    if (encoder -> wideProbeTableSize < 2 * numHaplotypes) {
+        encoder -> wideProbeTableSize = 1;
+        while (encoder -> wideProbeTableSize < 2 * numHaplotypes)
+            encoder -> wideProbeTableSize <<= 1;
+        free(encoder -> wideProbeTable);
+        encoder -> wideProbeTable = (WideProbeEntry*) calloc(encoder -> wideProbeTableSize, sizeof(WideProbeEntry));
+    }
+    unsigned int mask = encoder -> wideProbeTableSize - 1;
+    WideProbeEntry* table = encoder -> wideProbeTable;
+
+    // The right most leaf is labeled last.
+    unsigned long long missingLeaf = encoder -> numWideLeaves - 1;
+    unsigned int newLabel = 0;
+
+    for (int i = 0; i < numHaplotypes; i++) {
+        unsigned long long* haplotype = (i & 1) ? &(encoder -> rightWideHaplotype[i >> 1]) : &(encoder -> leftWideHaplotype[i >> 1]);
+        if (*haplotype == missingLeaf) {
+            *haplotype = ~0ULL;
+            continue;
+        }
+        // Find the encoding's slot, or the empty slot to put it in. A label of 0 marks an empty slot.
+        unsigned int slot = (unsigned int) ((*haplotype * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+        while (table[slot].label != 0 && table[slot].encoding != *haplotype)
+            slot = (slot + 1) & mask;
+        if (table[slot].label == 0) {
+            table[slot].encoding = *haplotype;
+            table[slot].label = ++newLabel;
+            encoder -> probeSlots[newLabel - 1] = slot;
+        }
+        *haplotype = table[slot].label - 1;
+    }
+
+    // Empty the slots that were filled.
+    for (int i = 0; i < newLabel; i++)
+        table[encoder -> probeSlots[i]].label = 0;
+
+    // For all of the haplotypes labeled with the right-most leaf of old tree, assign right-most label of new tree.
+    for (int i = 0; i < encoder -> numSamples; i++) {
+        if (encoder -> leftWideHaplotype[i] == ~0ULL)
+            encoder -> leftWideHaplotype[i] = newLabel;
+        if (encoder -> rightWideHaplotype[i] == ~0ULL)
+            encoder -> rightWideHaplotype[i] = newLabel;
+    }
+
+    INSTRUMENT_RELABEL(encoder -> numWideLeaves, newLabel + 1);
+
+    // New number of leaves.
+    encoder -> numWideLeaves = newLabel + 1;
+
+    INSTRUMENT_STOP(STAGE_RELABEL, timer);
+
+}
+
+void relabel_haplotypes(HaplotypeEncoder* encoder) {
+
+    INSTRUMENT_START(timer);
+
+    // Shards find their distinct encodings in parallel. Otherwise, index directly by encoding
+    //  if the table is not much larger than the number of haplotypes.
+    if (encoder -> shardPool != NULL)
+        relabel_haplotypes_sharded(encoder);
+    else if ((long) encoder -> numLeaves <= (long) DENSE_LABEL_FACTOR * 2 * encoder -> numSamples) {
+        // Probing does not index by encoding, so it handles encodings outside the tree.
+        if (!relabel_haplotypes_dense(encoder))
+            relabel_haplotypes_probe(encoder);
+    } else
+        relabel_haplotypes_probe(encoder);
+
+    INSTRUMENT_STOP(STAGE_RELABEL, timer);
+
+}
+
+void start_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder) {
+
+    // Set chromosome of next record from parser. Only copied when the chromosome changes.
+    if (!(encoder -> isChromosomeCurrent)) {
+        encoder -> chromosome -> l = 0;
+        kputsn(ks_str(parser -> nextChromosome), ks_len(parser -> nextChromosome), encoder -> chromosome);
+    }
 
     // Set start locus of next record from parser.
     encoder -> startLocus = parser -> nextPosition;
 
     // Reset tree.
     encoder -> numLeaves = 1;
+    encoder -> numWideLeaves = 1;
 
     // Empty haplotype.
     encoder -> numLoci = 0;
 
+}
+
+// Adds the locus last read by the parser to the haplotypes from the encoder's genotypes array.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser that read the locus.
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int numAlleles -> The number of alleles at the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+static inline void encode_locus(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGenotypes) {
+    // Use the bitplanes if the parser packed the locus.
+    INSTRUMENT_START(timer);
+    if (encoder -> isWide)
+        add_wide_locus(encoder, numAlleles, collapseMissingGenotypes);
+    else if (parser -> packed != NULL && parser -> packed -> isPacked)
+        add_packed_locus(encoder, parser -> packed, collapseMissingGenotypes);
+    else
+        add_locus(encoder, numAlleles, collapseMissingGenotypes);
+    INSTRUMENT_STOP(STAGE_ADD_LOCUS, timer);
+    encoder -> numLoci++;
+}
+
+void add_shared_locus(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, GENOTYPE* genotypes, int position, int numAlleles, bool collapseMissingGenotypes) {
+    // Encode from the shared array in place of the encoder's own.
+    GENOTYPE* ownGenotypes = encoder -> genotypes;
+    encoder -> genotypes = genotypes;
+    encode_locus(parser, encoder, numAlleles, collapseMissingGenotypes);
+    encoder -> genotypes = ownGenotypes;
+    encoder -> endLocus = position;
+}
+
+bool finish_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder) {
+
+    // Both variants end with first-seen labels. The 64-bit encodings are relabeled
+    //  once per haplotype into the 32-bit arrays.
+    if (encoder -> isWide) {
+        relabel_wide_haplotypes(encoder);
+        for (int i = 0; i < encoder -> numSamples; i++) {
+            encoder -> leftHaplotype[i] = encoder -> leftWideHaplotype[i];
+            encoder -> rightHaplotype[i] = encoder -> rightWideHaplotype[i];
+        }
+        encoder -> numLeaves = encoder -> numWideLeaves;
+    } else
+        relabel_haplotypes(encoder);
+
+    // The next locus is on the same chromosome.
+    encoder -> isChromosomeCurrent = !(parser -> isEOF) && parser -> contigId == parser -> nextContigId;
+
+    return encoder -> isChromosomeCurrent;
+
+}
+
+// Reads loci into the next haplotype until it holds HAP_SIZE loci, the next locus is past
+//  endPosition, or the chromosome changes.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser for the VCF file.
+//  HaplotypeEncoder* encoder -> The HaplotypeEncoder used to label unique haplotypes.
+//  bool collapseMissingGenotypes -> Is set, all samples with a missing genotype are set to the same haplotype.
+//  int HAP_SIZE -> The maximum number of loci in the haplotype.
+//  int endPosition -> The last position a locus of the haplotype can have.
+// Returns:
+//  bool, True if EOF was not reached and the next locus is on the same chromosome.
+static bool read_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int HAP_SIZE, int endPosition) {
+
+    // If EOF, there is no next haplotype.
+    if (parser -> isEOF)
+        return false;
+
+    start_haplotype(parser, encoder);
+
     // Used to flag if haplotype is on the same chromosome.
     bool isSameChromosome = true;
 
@@ -140,31 +885,46 @@ bool get_next_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bo
     int numAlleles;
 
     // Create the haplotype.
-    while(!(parser -> isEOF) && (encoder -> numLoci < HAP_SIZE) && isSameChromosome) {
+    while(!(parser -> isEOF) && (encoder -> numLoci < HAP_SIZE) && isSameChromosome && parser -> nextPosition <= endPosition) {
         // Get the next record from the VCF file.
-        get_next_locus(parser, encoder -> chromosome, &(encoder -> endLocus), &numAlleles, &(encoder -> genotypes));
+        get_next_locus(parser, NULL, &(encoder -> endLocus), &numAlleles, &(encoder -> genotypes));
         // Add locus to haplotype.
-        add_locus(encoder, numAlleles, collapseMissingGenotypes);
+        encode_locus(parser, encoder, numAlleles, collapseMissingGenotypes);
         // Make sure the next locus is on the same haplotype.
-        isSameChromosome = strcmp(ks_str(encoder -> chromosome), ks_str(parser -> nextChromosome)) == 0;
-        encoder -> numLoci++;
+        isSameChromosome = parser -> contigId == parser -> nextContigId;
     }
 
+    return finish_haplotype(parser, encoder);
+
+}
+
+bool get_next_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int HAP_SIZE) {
     // Not EOF, complete haplotype, and next loci is on the same chromsome.
-    return !(parser -> isEOF) && encoder -> numLoci == HAP_SIZE && isSameChromosome;
+    return read_haplotype(parser, encoder, collapseMissingGenotypes, HAP_SIZE, INT_MAX) && encoder -> numLoci == HAP_SIZE;
+}
 
+bool get_next_haplotype_in_span(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int endPosition) {
+    return read_haplotype(parser, encoder, collapseMissingGenotypes, INT_MAX, endPosition);
 }
 
 void destroy_haplotype_encoder(HaplotypeEncoder* encoder) {
 
+    // Stop the shard threads.
+    destroy_shard_pool(encoder -> shardPool);
     // Free memory used by arrays.
     free(encoder -> genotypes);
     free(encoder -> leftHaplotype);
     free(encoder -> rightHaplotype);
     // Free chromosome string.
     free(ks_str(encoder -> chromosome)); free(encoder -> chromosome);
-    // Free hash map.
-    kh_destroy(32, encoder -> labelMap);
+    // Free the relabeling tables.
+    free(encoder -> labelTable);
+    free(encoder -> probeTable);
+    free(encoder -> probeSlots);
+    free(encoder -> wideProbeTable);
+    // Free the 64-bit encodings.
+    free(encoder -> leftWideHaplotype);
+    free(encoder -> rightWideHaplotype);
     // Free structure.
     free(encoder);
 
@@ -185,8 +945,8 @@ void print_encoder_info(HaplotypeEncoder* encoder) {
 
 int main() {
 
-    VCFGenotypeParser* parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz");
-    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples);
+    VCFGenotypeParser* parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz", 0);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
     printf("\nTest 1\n");
     printf("---------\n");
     printf("Read in whole chromosomes:\n\n");
@@ -199,7 +959,7 @@ int main() {
     destroy_vcf_genotype_parser(parser);
 
     printf("\n");
-    parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz");
+    parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz", 0);
     printf("\nTest 2\n");
     printf("---------\n");
     printf("Read in 2-loci haplotypes:\n\n");
@@ -215,7 +975,7 @@ int main() {
     destroy_vcf_genotype_parser(parser);
 
     printf("\n");
-    parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz");
+    parser = init_vcf_genotype_parser("haplotype_encoder_test.vcf.gz", 0);
     printf("\nTest 3\n");
     printf("---------\n");
     printf("Read in 1-locus haplotypes:\n\n");
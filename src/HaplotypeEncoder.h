@@ -11,16 +11,102 @@
 
 #include <stdbool.h>
 
-#include "VCFGenotypeParser.h"
+#include <pthread.h>
 
-// Initialize klib hash table.
-#include "../klib/khash.h"
-KHASH_MAP_INIT_INT(32, int)
+#include "VCFGenotypeParser.h"
 
 // Max number of possible haplotypes before
 //  the algorithm will prune and relabel the tree.
 #define MAX_NUM_LEAVES (1 << 25)
 
+// Max number of possible haplotypes before the 64-bit encodings are relabeled.
+//  A locus has at most 16 alleles, so the next level cannot overflow.
+#define MAX_NUM_WIDE_LEAVES (1ULL << 59)
+
+// Relabeling uses a table indexed by encoding when the tree has at most
+//  this many leaves per haplotype. Otherwise, it uses an open addressing table.
+#define DENSE_LABEL_FACTOR 4
+
+// An entry in the open addressing table used for relabeling.
+//  Encodings never reach 0xFFFFFFFF, so it marks an empty slot.
+#define EMPTY_ENCODING 0xFFFFFFFF
+typedef struct {
+    // The old encoding.
+    unsigned int encoding;
+    // The new label.
+    unsigned int label;
+} ProbeEntry;
+
+// An entry in the open addressing table used to relabel 64-bit encodings.
+typedef struct {
+    // The old encoding.
+    unsigned long long encoding;
+    // One more than the new label. 0 marks an empty slot.
+    unsigned int label;
+} WideProbeEntry;
+
+// Samples are split into shards of this many samples when encoding is sharded. A shard's
+//  genotypes and encodings fit in L2. A multiple of 64, so shards start on a packed word.
+#define SHARD_SIZE 8192
+
+// The number of times an idle shard thread checks for a task before it sleeps.
+#define SHARD_SPINS 1024
+
+// A block of samples encoded by one thread at a time.
+typedef struct {
+    // The samples start ... end - 1.
+    int start;
+    int end;
+    // The open addressing table used to find the shard's distinct encodings.
+    ProbeEntry* probeTable;
+    int probeTableSize;
+    // The slots of the distinct encodings in the order they were first seen.
+    unsigned int* probeSlots;
+    int numDistinct;
+    // The label of each distinct encoding among all the shards.
+    unsigned int* labels;
+} EncoderShard;
+
+// The work the shard threads do.
+typedef enum {
+    SHARD_ADD_LOCUS,
+    SHARD_ADD_PACKED_LOCUS,
+    // Replaces each encoding with its index among the shard's distinct encodings.
+    SHARD_FIND_DISTINCT,
+    // Replaces each index with the encoding's label among all the shards.
+    SHARD_APPLY_LABELS
+} SHARD_TASK;
+
+// A pool of threads that run a task on every shard. The thread that starts a task
+//  works on the shards too, and returns once every shard is done.
+typedef struct {
+    EncoderShard* shards;
+    int numShards;
+    pthread_t* threads;
+    int numThreads;
+
+    // The task and its arguments.
+    SHARD_TASK task;
+    int numAlleles;
+    bool collapseMissingGenotypes;
+    PackedGenotypes* packed;
+    unsigned int missingLeaf;
+    unsigned int missingLabel;
+
+    // Incremented to start a task.
+    unsigned int generation;
+    // The next shard to claim.
+    int nextShard;
+    // The number of shards done.
+    int numDone;
+
+    // Idle threads sleep on the condition once they stop spinning.
+    int numSleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t taskStarted;
+    bool isShutdown;
+} ShardPool;
+
 // A structure to represent the encoder.
 typedef struct {
 
@@ -37,27 +123,117 @@ typedef struct {
     int numLoci;
     // Chromosome the haplotype rests on.
     kstring_t* chromosome;
+    // Set if the next locus is on the same chromosome as the last haplotype.
+    //  The name is then kept instead of copied again.
+    bool isChromosomeCurrent;
     // The start locus of the haplotype.
     int startLocus;
     // The end locus of the haplotype.
     int endLocus;
 
-    // A hash table used to relabel the encodings.
-    khash_t(32)* labelMap;
+    // A table indexed by encoding used to relabel small trees.
+    int* labelTable;
+    int labelTableSize;
+    // An open addressing table used to relabel the encodings.
+    ProbeEntry* probeTable;
+    int probeTableSize;
+    // The slots filled during a relabel.
+    unsigned int* probeSlots;
+
+    // If set, haplotypes are encoded in 64 bits and relabeled into leftHaplotype and
+    //  rightHaplotype once per haplotype, instead of whenever the tree outgrows 32 bits.
+    bool isWide;
+    unsigned long long* leftWideHaplotype;
+    unsigned long long* rightWideHaplotype;
+    // The number of leaves in the 64-bit haplotype tree.
+    unsigned long long numWideLeaves;
+    // An open addressing table used to relabel the 64-bit encodings.
+    WideProbeEntry* wideProbeTable;
+    int wideProbeTableSize;
 
     // The number of leaves in the haplotype tree.
     int numLeaves;
 
+    // If not NULL, the samples are encoded and relabeled shard by shard on a pool of threads.
+    ShardPool* shardPool;
+
 } HaplotypeEncoder;
 
 // Creates a HaplotypeEncoder structure.
 // Accepts:
 //  int numSamples -> The number of samples to track.
+//  bool isWide -> If set, haplotypes are encoded in 64 bits, so the tree is relabeled once or twice
+//                  per haplotype. finish_haplotype leaves the same labels as without it.
 // Returns:
 //  HaplotypeEncoder*, The created structure.
-HaplotypeEncoder* init_haplotype_encoder(int numSamples);
+HaplotypeEncoder* init_haplotype_encoder(int numSamples, bool isWide);
+
+// Splits the samples into shards of SHARD_SIZE samples, so adding loci and relabeling
+//  use a pool of threads. Produces the same encodings and labels as a single thread.
+//  Does nothing on a single core, with a single shard, or for 64-bit encodings.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int numThreads -> The number of threads working on the shards, including the caller.
+// Returns:
+//  void.
+void enable_sharded_encoding(HaplotypeEncoder* encoder, int numThreads);
+
+// Adds a locus to the haplotypes of each sample from the encoder's genotypes array.
+//  The locus starts the tree while numLoci is 0, as set by start_haplotype.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  int numAlleles -> The number of alleles at the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+void add_locus(HaplotypeEncoder* encoder, int numAlleles, bool collapseMissingGenotypes);
 
-// Read in the next haplotype from a VCF file.
+// Adds a biallelic locus to the haplotypes of each sample from packed bitplanes.
+//  Produces the same encodings as add_locus.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder.
+//  PackedGenotypes* packed -> The packed genotypes of the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+void add_packed_locus(HaplotypeEncoder* encoder, PackedGenotypes* packed, bool collapseMissingGenotypes);
+
+// The next three functions build a haplotype one locus at a time, so a locus read once can
+//  be added to several encoders. get_next_haplotype is built from them.
+
+// Starts an empty haplotype at the parser's next record.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser for the VCF file. Must not be EOF.
+//  HaplotypeEncoder* encoder -> The encoder.
+// Returns:
+//  void.
+void start_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder);
+
+// Adds the locus last read by the parser to the haplotype. The genotypes are read from
+//  the caller's array, so several encoders can share it.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser that read the locus. Its packed planes are used if set.
+//  HaplotypeEncoder* encoder -> The encoder.
+//  GENOTYPE* genotypes -> The genotypes of the locus, as set by get_next_locus.
+//  int position -> The position of the locus.
+//  int numAlleles -> The number of alleles at the locus.
+//  bool collapseMissingGenotypes -> If set, samples with a missing allele are moved to the right most leaf.
+// Returns:
+//  void.
+void add_shared_locus(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, GENOTYPE* genotypes, int position, int numAlleles, bool collapseMissingGenotypes);
+
+// Ends the haplotype after its last locus. The parser must not have read past it.
+//  Relabels leftHaplotype and rightHaplotype with first-seen labels, the missing leaf last,
+//  and sets numLeaves to the number of labels. This is a pass over the samples per haplotype.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser for the VCF file.
+//  HaplotypeEncoder* encoder -> The encoder.
+// Returns:
+//  bool, True if EOF was not reached and the next locus is on the same chromosome.
+bool finish_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder);
+
+// Read in the next haplotype from a VCF file. The haplotypes hold first-seen labels,
+//  not raw encodings. See finish_haplotype.
 // Accepts:
 //  VCFGenotypeParser* parser -> The parser for the VCF file.
 //  HaplotypeEncoder* encoder -> The HaplotypeEncoder used to label unique haplotypes.
@@ -67,6 +243,16 @@ HaplotypeEncoder* init_haplotype_encoder(int numSamples);
 //  bool, Returns true if the haplotype contains HAP_SIZE loci and the next loci is on the same chromosome and EOF was not reached.
 bool get_next_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int HAP_SIZE);
 
+// Read in the loci up to a position as the next haplotype. Used for windows of a fixed span.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser for the VCF file.
+//  HaplotypeEncoder* encoder -> The HaplotypeEncoder used to label unique haplotypes.
+//  bool collapseMissingGenotypes -> Is set, all samples with a missing genotype are set to the same haplotype, which is numLeaves.
+//  int endPosition -> The last position of the haplotype. The next locus must be at or before it.
+// Returns:
+//  bool, Returns true if the next loci is on the same chromosome and EOF was not reached.
+bool get_next_haplotype_in_span(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bool collapseMissingGenotypes, int endPosition);
+
 // Relabels haplotype encodings. Simplifies tree.
 // Accepts:
 //  HaplotypeEncoder* encoder -> The encoder to simplify.
@@ -74,6 +260,13 @@ bool get_next_haplotype(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, bo
 //  void.
 void relabel_haplotypes(HaplotypeEncoder* encoder);
 
+// Relabels the 64-bit haplotype encodings with first-seen labels.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder to simplify.
+// Returns:
+//  void.
+void relabel_wide_haplotypes(HaplotypeEncoder* encoder);
+
 // Deallocated memory used by the encoder.
 // Accepts:
 //  HaplotypeEncoder* encoder -> The encoder to deallocate.
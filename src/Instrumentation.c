@@ -0,0 +1,197 @@
+// File: Instrumentation.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Optional counters for the hot paths. Compiled in with make INSTRUMENT=1.
+
+#include "Instrumentation.h"
+
+#ifdef INSTRUMENT
+
+#include <stdio.h>
+
+#include <stdbool.h>
+
+#include <string.h>
+
+#include <time.h>
+
+#include <pthread.h>
+
+// Counters are shared by the inflate workers, the pipeline's parser thread, and the
+//  consumer, so they are updated atomically. Ordering does not matter.
+#define ATOMIC_ADD(counter, value) __atomic_fetch_add(&(counter), value, __ATOMIC_RELAXED)
+
+// The names of the stages in reports.
+static const char* stageNames[NUM_STAGES] = { "inflate", "read", "tokenize", "genotypes", "add_locus", "relabel", "window" };
+
+// The number of power-of-two buckets for relabel sizes.
+#define NUM_RELABEL_BUCKETS 64
+
+// The loci and cycles of a chromosome.
+typedef struct {
+    char* name;
+    unsigned long long numLoci;
+    unsigned long long cycles;
+} ChromosomeCounter;
+
+static unsigned long long stageCycles[NUM_STAGES];
+static unsigned long long stageCalls[NUM_STAGES];
+static unsigned long long numRelabels;
+static unsigned long long leavesBeforeRelabel;
+static unsigned long long leavesAfterRelabel;
+static unsigned long long maxLeavesBeforeRelabel;
+// relabelBuckets[i] counts relabels of trees with 2^i to 2^(i + 1) - 1 leaves.
+static unsigned long long relabelBuckets[NUM_RELABEL_BUCKETS];
+static unsigned long long numInflatedBytes;
+
+// Chromosomes are recorded once per window, so a lock is cheap enough.
+static pthread_mutex_t chromosomeLock = PTHREAD_MUTEX_INITIALIZER;
+static ChromosomeCounter* chromosomes = NULL;
+static int numChromosomes = 0, maxChromosomes = 0, lastChromosome = -1;
+
+static char* sidecarName = NULL;
+
+// The clock and cycle counter when counting started. Used to convert cycles into seconds.
+static struct timespec startTime;
+static unsigned long long startCycles;
+
+#if !defined(__x86_64__) && !defined(__i386__)
+unsigned long long read_cycles() {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000000000ULL + t.tv_nsec;
+}
+#endif
+
+// Starts the calibration interval before main runs.
+__attribute__((constructor)) static void start_calibration() {
+    clock_gettime(CLOCK_MONOTONIC, &startTime);
+    startCycles = read_cycles();
+}
+
+// Returns the cycles per second measured since counting started.
+static double cycles_per_second() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    unsigned long long cycles = read_cycles() - startCycles;
+    double seconds = (now.tv_sec - startTime.tv_sec) + (now.tv_nsec - startTime.tv_nsec) * 1e-9;
+    return seconds > 0 && cycles > 0 ? cycles / seconds : 1e9;
+}
+
+void record_stage(InstrumentedStage stage, unsigned long long cycles) {
+    ATOMIC_ADD(stageCycles[stage], cycles);
+    ATOMIC_ADD(stageCalls[stage], 1);
+}
+
+void record_relabel(unsigned long long numLeavesBefore, unsigned long long numLeavesAfter) {
+    ATOMIC_ADD(numRelabels, 1);
+    ATOMIC_ADD(leavesBeforeRelabel, numLeavesBefore);
+    ATOMIC_ADD(leavesAfterRelabel, numLeavesAfter);
+    int bucket = numLeavesBefore > 0 ? 63 - __builtin_clzll(numLeavesBefore) : 0;
+    ATOMIC_ADD(relabelBuckets[bucket], 1);
+    unsigned long long max = __atomic_load_n(&maxLeavesBeforeRelabel, __ATOMIC_RELAXED);
+    while (numLeavesBefore > max && !__atomic_compare_exchange_n(&maxLeavesBeforeRelabel, &max, numLeavesBefore, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+}
+
+void record_inflated_bytes(unsigned long long numBytes) {
+    ATOMIC_ADD(numInflatedBytes, numBytes);
+}
+
+void record_chromosome(char* chromosome, unsigned long long numLoci, unsigned long long cycles) {
+    pthread_mutex_lock(&chromosomeLock);
+    // Consecutive windows are usually on the same chromosome.
+    int i = lastChromosome;
+    if (i < 0 || strcmp(chromosomes[i].name, chromosome) != 0) {
+        for (i = 0; i < numChromosomes && strcmp(chromosomes[i].name, chromosome) != 0; i++);
+        if (i == numChromosomes) {
+            if (numChromosomes == maxChromosomes) {
+                maxChromosomes = maxChromosomes == 0 ? 16 : 2 * maxChromosomes;
+                chromosomes = (ChromosomeCounter*) realloc(chromosomes, maxChromosomes * sizeof(ChromosomeCounter));
+            }
+            chromosomes[i].name = strdup(chromosome);
+            chromosomes[i].numLoci = 0;
+            chromosomes[i].cycles = 0;
+            numChromosomes++;
+        }
+        lastChromosome = i;
+    }
+    chromosomes[i].numLoci += numLoci;
+    chromosomes[i].cycles += cycles;
+    pthread_mutex_unlock(&chromosomeLock);
+}
+
+void set_instrumentation_sidecar(char* file_name) {
+    free(sidecarName);
+    sidecarName = file_name != NULL ? strdup(file_name) : NULL;
+}
+
+// Writes the counters as a table.
+static void write_table(FILE* out, double cyclesPerSecond) {
+    fprintf(out, "\nInstrumentation (%.3f GHz counter)\n", cyclesPerSecond * 1e-9);
+    fprintf(out, "%-12s %16s %12s %12s\n", "Stage", "Cycles", "Calls", "Seconds");
+    for (int i = 0; i < NUM_STAGES; i++)
+        fprintf(out, "%-12s %16llu %12llu %12.3f\n", stageNames[i], stageCycles[i], stageCalls[i], stageCycles[i] / cyclesPerSecond);
+    fprintf(out, "Bytes Inflated: %llu\n", numInflatedBytes);
+    fprintf(out, "Relabels: %llu, Mean Leaves Before: %.1f, Mean Leaves After: %.1f, Max Leaves Before: %llu\n", numRelabels,
+        numRelabels > 0 ? (double) leavesBeforeRelabel / numRelabels : 0, numRelabels > 0 ? (double) leavesAfterRelabel / numRelabels : 0, maxLeavesBeforeRelabel);
+    for (int i = 0; i < NUM_RELABEL_BUCKETS; i++)
+        if (relabelBuckets[i] > 0)
+            fprintf(out, "  Leaves in [2^%d, 2^%d): %llu\n", i, i + 1, relabelBuckets[i]);
+    fprintf(out, "%-20s %12s %12s %14s\n", "Chromosome", "Loci", "Seconds", "Loci/s");
+    for (int i = 0; i < numChromosomes; i++) {
+        double seconds = chromosomes[i].cycles / cyclesPerSecond;
+        fprintf(out, "%-20s %12llu %12.3f %14.0f\n", chromosomes[i].name, chromosomes[i].numLoci, seconds, seconds > 0 ? chromosomes[i].numLoci / seconds : 0);
+    }
+    fprintf(out, "\n");
+}
+
+// Writes the counters as a JSON object.
+static void write_json(FILE* out, double cyclesPerSecond) {
+    fprintf(out, "{\n  \"cyclesPerSecond\": %.0f,\n  \"stages\": {\n", cyclesPerSecond);
+    for (int i = 0; i < NUM_STAGES; i++)
+        fprintf(out, "    \"%s\": { \"cycles\": %llu, \"calls\": %llu, \"seconds\": %.6f }%s\n", stageNames[i], stageCycles[i], stageCalls[i], stageCycles[i] / cyclesPerSecond, i + 1 < NUM_STAGES ? "," : "");
+    fprintf(out, "  },\n  \"bytesInflated\": %llu,\n", numInflatedBytes);
+    fprintf(out, "  \"relabels\": { \"count\": %llu, \"leavesBefore\": %llu, \"leavesAfter\": %llu, \"maxLeavesBefore\": %llu, \"log2LeavesBefore\": [", numRelabels, leavesBeforeRelabel, leavesAfterRelabel, maxLeavesBeforeRelabel);
+    int numBuckets = NUM_RELABEL_BUCKETS;
+    while (numBuckets > 0 && relabelBuckets[numBuckets - 1] == 0)
+        numBuckets--;
+    for (int i = 0; i < numBuckets; i++)
+        fprintf(out, "%s%llu", i > 0 ? ", " : "", relabelBuckets[i]);
+    fprintf(out, "] },\n  \"chromosomes\": [\n");
+    for (int i = 0; i < numChromosomes; i++) {
+        double seconds = chromosomes[i].cycles / cyclesPerSecond;
+        fprintf(out, "    { \"name\": \"%s\", \"loci\": %llu, \"seconds\": %.6f, \"lociPerSecond\": %.0f }%s\n", chromosomes[i].name, chromosomes[i].numLoci, seconds,
+            seconds > 0 ? chromosomes[i].numLoci / seconds : 0, i + 1 < numChromosomes ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+void report_instrumentation() {
+
+    double cyclesPerSecond = cycles_per_second();
+
+    pthread_mutex_lock(&chromosomeLock);
+    FILE* sidecar = sidecarName != NULL ? fopen(sidecarName, "w") : NULL;
+    if (sidecar != NULL) {
+        write_json(sidecar, cyclesPerSecond);
+        fclose(sidecar);
+    } else {
+        if (sidecarName != NULL)
+            fprintf(stderr, "Could not write %s.\n", sidecarName);
+        write_table(stderr, cyclesPerSecond);
+    }
+
+    // Start counting the next run.
+    memset(stageCycles, 0, sizeof(stageCycles));
+    memset(stageCalls, 0, sizeof(stageCalls));
+    memset(relabelBuckets, 0, sizeof(relabelBuckets));
+    numRelabels = leavesBeforeRelabel = leavesAfterRelabel = maxLeavesBeforeRelabel = numInflatedBytes = 0;
+    for (int i = 0; i < numChromosomes; i++)
+        free(chromosomes[i].name);
+    numChromosomes = 0;
+    lastChromosome = -1;
+    pthread_mutex_unlock(&chromosomeLock);
+
+}
+
+#endif
@@ -0,0 +1,110 @@
+// File: Instrumentation.h
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Optional counters for the hot paths. Compiled in with make INSTRUMENT=1.
+//  Without it, the macros expand to nothing and the hot paths are untouched.
+
+#ifndef _INSTRUMENTATION_
+#define _INSTRUMENTATION_
+
+#include <stdlib.h>
+
+// The timed stages. Stages nest where the code does: READ includes the inflation done on
+//  the reading thread, and ADD_LOCUS includes the relabels a locus triggers.
+typedef enum {
+    // Inflating BGZF blocks or gzip data, on any thread.
+    STAGE_INFLATE,
+    // Reading the next line of the file.
+    STAGE_READ,
+    // Splitting the first nine fields of a record.
+    STAGE_TOKENIZE,
+    // Decoding, copying, and packing the genotypes of a record.
+    STAGE_GENOTYPES,
+    // Adding a locus to the haplotypes.
+    STAGE_ADD_LOCUS,
+    // Relabeling the haplotypes.
+    STAGE_RELABEL,
+    // Building a window, excluding the haplotypes read into it.
+    STAGE_WINDOW,
+    NUM_STAGES
+} InstrumentedStage;
+
+#ifdef INSTRUMENT
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define read_cycles() __rdtsc()
+#else
+// Nanoseconds stand in for cycles.
+unsigned long long read_cycles();
+#endif
+
+// Adds the cycles of one call to a stage.
+// Accepts:
+//  InstrumentedStage stage -> The stage.
+//  unsigned long long cycles -> The cycles the call took.
+// Returns:
+//  void.
+void record_stage(InstrumentedStage stage, unsigned long long cycles);
+
+// Counts a relabel event.
+// Accepts:
+//  unsigned long long numLeavesBefore -> The leaves of the tree before relabeling.
+//  unsigned long long numLeavesAfter -> The leaves of the tree after relabeling.
+// Returns:
+//  void.
+void record_relabel(unsigned long long numLeavesBefore, unsigned long long numLeavesAfter);
+
+// Counts the bytes produced by inflation.
+// Accepts:
+//  unsigned long long numBytes -> The number of inflated bytes.
+// Returns:
+//  void.
+void record_inflated_bytes(unsigned long long numBytes);
+
+// Adds a window's loci and cycles to its chromosome.
+// Accepts:
+//  char* chromosome -> The chromosome of the window.
+//  unsigned long long numLoci -> The loci read into the window.
+//  unsigned long long cycles -> The cycles spent building the window, including its haplotypes.
+// Returns:
+//  void.
+void record_chromosome(char* chromosome, unsigned long long numLoci, unsigned long long cycles);
+
+// Writes later reports as JSON to a file instead of a table to stderr.
+// Accepts:
+//  char* file_name -> The JSON file. If NULL, reports go back to stderr.
+// Returns:
+//  void.
+void set_instrumentation_sidecar(char* file_name);
+
+// Writes the counters and resets them.
+// Accepts:
+//  void.
+// Returns:
+//  void.
+void report_instrumentation();
+
+#define INSTRUMENT_START(timer) unsigned long long timer = read_cycles()
+#define INSTRUMENT_STOP(stage, timer) record_stage(stage, read_cycles() - (timer))
+// Leaves the cycles since start out of a running timer, so a nested stage is not counted twice.
+#define INSTRUMENT_EXCLUDE(timer, start) (timer) += read_cycles() - (start)
+#define INSTRUMENT_RELABEL(before, after) record_relabel(before, after)
+#define INSTRUMENT_INFLATED(numBytes) record_inflated_bytes(numBytes)
+#define INSTRUMENT_CHROMOSOME(chromosome, numLoci, timer) record_chromosome(chromosome, numLoci, read_cycles() - (timer))
+#define INSTRUMENT_REPORT() report_instrumentation()
+
+#else
+
+#define INSTRUMENT_START(timer)
+#define INSTRUMENT_STOP(stage, timer)
+#define INSTRUMENT_EXCLUDE(timer, start)
+#define INSTRUMENT_RELABEL(before, after)
+#define INSTRUMENT_INFLATED(numBytes)
+#define INSTRUMENT_CHROMOSOME(chromosome, numLoci, timer) ((void) (numLoci))
+#define INSTRUMENT_REPORT()
+#define set_instrumentation_sidecar(file_name) ((void) (file_name))
+
+#endif
+
+#endif
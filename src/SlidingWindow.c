@@ -6,71 +6,248 @@
 
 #include "SlidingWindow.h"
 
+#include <pthread.h>
+
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+// Starts filling a window. Removes the haplotypes that left with the offset.
+// Accepts:
+//  Window* currentWindow -> The window to fill. Its numLoci holds the loci in the overlap.
+//  WindowStatistics* statistics -> The statistics of the haplotypes in the overlap.
+//  int contigId -> The id of the chromosome of the window's first haplotype.
+//  char* chromosome -> The name of the chromosome of the window's first haplotype.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+// Returns:
+//  int, The number of haplotypes within the overlap from the previous window.
+static int begin_window(Window* currentWindow, WindowStatistics* statistics, int contigId, char* chromosome, int HAP_SIZE) {
+
+    // Pooled windows share the pool's copy of the name.
+    if (currentWindow -> pool != NULL)
+        currentWindow -> chromosome = intern_chromosome(currentWindow -> pool, contigId, chromosome);
+    else
+        kputs(chromosome, currentWindow -> chromosome);
+
+    // Number of haplotypes within the overlap from the previous window.
+    int numHapsInOverlap = currentWindow -> numLoci / HAP_SIZE;
+
+    // The haplotypes before the overlap left with the offset. On a new chromosome, all of them did.
+    remove_haplotype_statistics(statistics, statistics -> numHaplotypes - numHapsInOverlap);
+
+    return numHapsInOverlap;
+
+}
+
+// Adds the encoder's relabeled haplotype to the end of a window.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder holding the haplotype.
+//  Window* currentWindow -> The window being filled.
+//  int* startLoci -> An array to hold the start loci of the next windows within the current window.
+//  WindowStatistics* statistics -> The statistics of the haplotypes in the window.
+//  int numHapsInOverlap -> The number of haplotypes already in the window.
+//  int WINDOW_SIZE -> The number of haplotypes in the window.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+// Returns:
+//  void.
+static void add_haplotype_to_window(HaplotypeEncoder* encoder, Window* currentWindow, int* startLoci, WindowStatistics* statistics, int numHapsInOverlap, int WINDOW_SIZE, int OFFSET_SIZE) {
+    add_haplotype_statistics(statistics, encoder -> leftHaplotype, encoder -> rightHaplotype, encoder -> numSamples, encoder -> numLeaves, encoder -> numLoci);
+    // If the haplotype encountered is a start position for a future window, save the haplotype's start position.
+    if (numHapsInOverlap % OFFSET_SIZE == 0)
+        startLoci[(currentWindow -> windowNumOnChromosome + numHapsInOverlap) % ((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1)] = encoder -> startLocus;
+    currentWindow -> numLoci += encoder -> numLoci;
+}
+
+// Completes a window after its last haplotype and sets up the next window.
+// Accepts:
+//  HaplotypeEncoder* encoder -> The encoder holding the window's last haplotype.
+//  Window* currentWindow -> The filled window.
+//  Window* nextWindow -> A reset window that is set up as the window after currentWindow.
+//  int* startLoci -> The start loci of the windows within the current window.
+//  WindowStatistics* statistics -> The statistics of the haplotypes in the window.
+//  bool isSameChromosome -> Set if the next haplotype is on the same chromosome.
+//  int WINDOW_SIZE -> The number of haplotypes in the window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+// Returns:
+//  void.
+static void end_window(HaplotypeEncoder* encoder, Window* currentWindow, Window* nextWindow, int* startLoci, WindowStatistics* statistics, bool isSameChromosome, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+    // Set start locus of the currentWindow.
+    currentWindow -> startLocus = startLoci[currentWindow -> windowNumOnChromosome % ((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1)];
+    // Set end locus of the currentWindow.
+    currentWindow -> endLocus = encoder -> endLocus;
+    // Set the statistics of the currentWindow's haplotypes.
+    set_window_statistics(statistics, currentWindow);
+    // Set window number for the next window.
+    nextWindow -> windowNum = currentWindow -> windowNum + 1;
+    // If the next window is on the same chromsome ...
+    if (isSameChromosome) {
+        // Subtract number of loci within the offset.
+        nextWindow -> numLoci = currentWindow -> numLoci - (HAP_SIZE * OFFSET_SIZE);
+        // Next window on the same chromosome.
+        nextWindow -> windowNumOnChromosome = currentWindow -> windowNumOnChromosome + 1;
+    } else {
+        // If next window is on a different chromosome, then reset counters.
+        nextWindow -> numLoci = 0;
+        nextWindow -> windowNumOnChromosome = 1;
+    }
+}
+
 // A method to get the next window in sliding process.
 // Accepts:
 //  VCFGenotypeParser* parser -> The VCF parser.
 //  HaplotypeEncoder* encoder -> The encoder used to label haplotypes.
 //  Window* currentWindow -> The window currently being processed. Needed for overlap
 //                              calculations to crete the next window.
+//  Window* nextWindow -> A reset window that is set up as the window after currentWindow.
 //  int* startLoci -> An array to hold the start loci of the next windows within the current window.
+//  WindowStatistics* statistics -> The statistics of the haplotypes in the overlap. Haplotypes
+//                                  are added as they are read and removed as they leave.
 //  int WINDOW_SIZE -> The number of haplotypes in the window.
 //  int HAP_SIZE -> The number of loci in a haplotype.
 //  int OFFSET_SIZE -> The number of haplotypes in the offset.
-Window* get_next_window(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, Window* currentWindow, int* startLoci, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+// Returns:
+//  bool, False if EOF and currentWindow was not filled.
+bool get_next_window(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, Window* currentWindow, Window* nextWindow, int* startLoci, WindowStatistics* statistics, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
     
     // If EOF, there is no new window.
     if (parser -> isEOF)
-        return NULL;
-    
-    // Allocate the next window.
-    Window* nextWindow = init_window();
+        return false;
+
+    // Time the window as a whole and without its haplotypes.
+    INSTRUMENT_START(chromosomeTimer);
+    INSTRUMENT_START(windowTimer);
+
+    int numLociInOverlap = currentWindow -> numLoci;
 
     // Current window lies on the chromosome of the next VCF record.
-    kputs(ks_str(parser -> nextChromosome), currentWindow -> chromosome);
+    int numHapsInOverlap = begin_window(currentWindow, statistics, parser -> nextContigId, ks_str(parser -> nextChromosome), HAP_SIZE);
 
     // Flag used to determine if next haplotype is on the same chromsome.
     bool isSameChromosome = true;
 
-    // Number of haplotypes within the overlap from the previous window.
-    int numHapsInOverlap = currentWindow -> numLoci / HAP_SIZE;
-
     // Read in the next window.
     while(numHapsInOverlap < WINDOW_SIZE && isSameChromosome) {
         // Get the next haplotype.
+        INSTRUMENT_START(haplotypeTimer);
         isSameChromosome = get_next_haplotype(parser, encoder, true, HAP_SIZE);
+        INSTRUMENT_EXCLUDE(windowTimer, haplotypeTimer);
 
         // Process haplotype.
-
-        // If the haplotype encountered is a start position for a future window, save the haplotype's start position.
-        if (numHapsInOverlap % OFFSET_SIZE == 0)
-            startLoci[(currentWindow -> windowNumOnChromosome + numHapsInOverlap) % ((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1)] = encoder -> startLocus;
-        currentWindow -> numLoci += encoder -> numLoci;
+        add_haplotype_to_window(encoder, currentWindow, startLoci, statistics, numHapsInOverlap, WINDOW_SIZE, OFFSET_SIZE);
         numHapsInOverlap++;
     }
-    // Set start locus of the currentWindow.
-    currentWindow -> startLocus = startLoci[currentWindow -> windowNumOnChromosome % ((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1)];
-    // Set end locus of the currentWindow.
-    currentWindow -> endLocus = encoder -> endLocus;
-    // Set window number for the next window.
-    nextWindow -> windowNum = currentWindow -> windowNum + 1;
-    // If the next window is on the same chromsome ...
-    if (isSameChromosome) {
-        // Subtract number of loci within the offset.
-        nextWindow -> numLoci = currentWindow -> numLoci - (HAP_SIZE * OFFSET_SIZE);
-        // Next window on the same chromosome.
-        nextWindow -> windowNumOnChromosome = currentWindow -> windowNumOnChromosome + 1;
-    } else {
-        // If next window is on a different chromosome, then reset counters.
-        nextWindow -> numLoci = 0;
-        nextWindow -> windowNumOnChromosome = 1;
+    end_window(encoder, currentWindow, nextWindow, startLoci, statistics, isSameChromosome, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
+
+    INSTRUMENT_STOP(STAGE_WINDOW, windowTimer);
+    INSTRUMENT_CHROMOSOME(ks_str(currentWindow -> chromosome), currentWindow -> numLoci - numLociInOverlap, chromosomeTimer);
+
+    // The current window was filled.
+    return true;
+
+}
+
+// Checks the spans of windows of a fixed span. See slide_through_genome_by_span.
+static bool is_valid_span(int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN) {
+    return WINDOW_SPAN > 0 && HAP_SPAN > 0 && STEP_SPAN > 0 && STEP_SPAN % HAP_SPAN == 0 && WINDOW_SPAN % STEP_SPAN == 0;
+}
+
+// A method to get the next window of a fixed span in the sliding process. Windows on a
+//  chromosome start at 1, 1 + STEP_SPAN, 1 + 2 * STEP_SPAN, ... and windows without loci
+//  are skipped. The haplotypes are the tiles of HAP_SPAN bp from position 1, so the window's
+//  haplotypes do not depend on STEP_SPAN. A step removes STEP_SPAN / HAP_SPAN tiles from the
+//  statistics ring.
+// Accepts:
+//  VCFGenotypeParser* parser -> The VCF parser.
+//  HaplotypeEncoder* encoder -> The encoder used to label haplotypes.
+//  Window* currentWindow -> The window currently being processed.
+//  Window* nextWindow -> A reset window that is set up as the window after currentWindow.
+//  int* windowStarts -> A ring of WINDOW_SPAN / STEP_SPAN positions. Holds the start positions
+//                          of the windows that begin within the current window.
+//  WindowStatistics* statistics -> The statistics of the tiles in the overlap.
+//  int WINDOW_SPAN -> The number of bp in a window.
+//  int HAP_SPAN -> The number of bp in a haplotype.
+//  int STEP_SPAN -> The number of bp between the starts of consecutive windows.
+// Returns:
+//  bool, False if EOF and no loci are left for currentWindow.
+static bool get_next_span_window(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, Window* currentWindow, Window* nextWindow, int* windowStarts, WindowStatistics* statistics, int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN) {
+
+    INSTRUMENT_START(chromosomeTimer);
+    INSTRUMENT_START(windowTimer);
+
+    int numTilesInWindow = WINDOW_SPAN / HAP_SPAN, numTilesInStep = STEP_SPAN / HAP_SPAN;
+    int numWindowStarts = WINDOW_SPAN / STEP_SPAN;
+
+    // The number of loci read into the window by this call.
+    int numLociRead = 0;
+
+    // Until the window holds a locus.
+    do {
+        // If the overlap holds no loci, jump to the first window that holds the next locus.
+        if (statistics -> numLoci == 0) {
+            if (parser -> isEOF)
+                return false;
+            remove_haplotype_statistics(statistics, statistics -> numHaplotypes);
+            // The next locus starts a new chromosome.
+            if (parser -> contigId != parser -> nextContigId)
+                currentWindow -> windowNumOnChromosome = 1;
+            // The first window that ends at or after the next locus.
+            int windowIndex = parser -> nextPosition > WINDOW_SPAN ? (parser -> nextPosition - WINDOW_SPAN + STEP_SPAN - 1) / STEP_SPAN : 0;
+            windowStarts[currentWindow -> windowNumOnChromosome % numWindowStarts] = 1 + windowIndex * STEP_SPAN;
+        }
+
+        // Flag used to determine if the next locus is on the window's chromosome. After a jump,
+        //  the window is on the chromosome of the next locus.
+        bool isSameChromosome = !(parser -> isEOF) && (statistics -> numLoci == 0 || parser -> contigId == parser -> nextContigId);
+
+        // Read in the tiles after the overlap. A tile that starts a window saves its start.
+        int windowStart = windowStarts[currentWindow -> windowNumOnChromosome % numWindowStarts];
+        while (statistics -> numHaplotypes < numTilesInWindow) {
+            int tileStart = windowStart + statistics -> numHaplotypes * HAP_SPAN, tileEnd = tileStart + HAP_SPAN - 1;
+            if (statistics -> numHaplotypes % numTilesInStep == 0)
+                windowStarts[(currentWindow -> windowNumOnChromosome + statistics -> numHaplotypes / numTilesInStep) % numWindowStarts] = tileStart;
+            if (isSameChromosome && parser -> nextPosition <= tileEnd) {
+                INSTRUMENT_START(haplotypeTimer);
+                isSameChromosome = get_next_haplotype_in_span(parser, encoder, true, tileEnd);
+                INSTRUMENT_EXCLUDE(windowTimer, haplotypeTimer);
+                add_haplotype_statistics(statistics, encoder -> leftHaplotype, encoder -> rightHaplotype, encoder -> numSamples, encoder -> numLeaves, encoder -> numLoci);
+                numLociRead += encoder -> numLoci;
+            } else {
+                // A tile without loci.
+                add_haplotype_statistics(statistics, NULL, NULL, 0, 1, 0);
+            }
+        }
+    } while (statistics -> numLoci == 0);
+
+    // The window lies on the chromosome of the last locus read.
+    if (currentWindow -> pool != NULL)
+        currentWindow -> chromosome = intern_chromosome(currentWindow -> pool, parser -> contigId, ks_str(encoder -> chromosome));
+    else {
+        currentWindow -> chromosome -> l = 0;
+        kputs(ks_str(encoder -> chromosome), currentWindow -> chromosome);
     }
+    // The window covers its whole span, even past the last locus.
+    currentWindow -> startLocus = windowStarts[currentWindow -> windowNumOnChromosome % numWindowStarts];
+    currentWindow -> endLocus = currentWindow -> startLocus + WINDOW_SPAN - 1;
+    currentWindow -> numLoci = statistics -> numLoci;
+    set_window_statistics(statistics, currentWindow);
+
+    // Set up the next window on the same chromosome. If it holds no loci, the next call jumps.
+    nextWindow -> windowNum = currentWindow -> windowNum + 1;
+    nextWindow -> windowNumOnChromosome = currentWindow -> windowNumOnChromosome + 1;
+    remove_haplotype_statistics(statistics, numTilesInStep);
+
+    INSTRUMENT_STOP(STAGE_WINDOW, windowTimer);
+    INSTRUMENT_CHROMOSOME(ks_str(currentWindow -> chromosome), numLociRead, chromosomeTimer);
 
-    // Return the newly allocated window.
-    return nextWindow;
+    // The current window was filled.
+    return true;
 
 }
 
-klist_t(WindowPtr)* slide_through_genome(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+// Slides through the parser's records. See slide_through_genome. The threads of
+//  slide_through_genome_parallel call this directly, so the report is written once.
+static klist_t(WindowPtr)* slide_windows(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
     
     // If EOF, there are no windows to process.
     if (parser -> isEOF)
@@ -81,44 +258,641 @@ klist_t(WindowPtr)* slide_through_genome(VCFGenotypeParser* parser, HaplotypeEnc
 
     // Allocate our list of start locations.
     int* startLoci = (int*) calloc((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1, sizeof(int));
+
+    // The statistics of the haplotypes in the window.
+    WindowStatistics* statistics = init_window_statistics(WINDOW_SIZE);
     
+    // Windows are taken from a pool. The pool lives until the last window in the list is destroyed.
+    WindowPool* pool = init_window_pool();
+
     // Create the first window.
-    Window* currentWindow = init_window();
+    Window* currentWindow = take_window(pool);
 
     // Will hold pointer to next window.
-    Window* nextWindow = NULL;
-
-    // Used to swap curretWindow and nextWindow.
-    Window* temp = NULL;
+    Window* nextWindow = take_window(pool);
 
     // While there is a window to process.
-    while ((nextWindow = get_next_window(parser, encoder, currentWindow, startLoci, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE)) != NULL) {
+    while (get_next_window(parser, encoder, currentWindow, nextWindow, startLoci, statistics, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE)) {
 
         // Process currentWindow.
         
         // Add the currentWindow to the list.
         *kl_pushp(WindowPtr, windows) = currentWindow;
 
-        // Swap currentWindow and nextWindow.
-        temp = currentWindow;
+        // The next window becomes the currentWindow.
         currentWindow = nextWindow;
-        nextWindow = temp;
+        nextWindow = take_window(pool);
 
     }
 
-    // The last window becomes the currentWindow, is unused, and not added to list.
-    //  Free unused window.
+    // The last two windows are unused, and not added to list.
+    //  Free unused windows. The pool is freed with the last window in the list.
+    release_window_pool(pool);
     destroy_window(currentWindow);
+    destroy_window(nextWindow);
 
-    // Free startLoci array.
+    // Free startLoci array and the statistics.
     free(startLoci);
+    destroy_window_statistics(statistics);
 
     // Return the structure.
     return windows;
 
 }
 
-// Used to test sliding window.
+klist_t(WindowPtr)* slide_through_genome(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+    klist_t(WindowPtr)* windows = slide_windows(parser, encoder, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
+    INSTRUMENT_REPORT();
+    return windows;
+}
+
+klist_t(WindowPtr)* slide_through_genome_by_span(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN) {
+
+    // If EOF or the spans do not tile the windows, there are no windows to process.
+    if (parser -> isEOF || !is_valid_span(WINDOW_SPAN, HAP_SPAN, STEP_SPAN))
+        return NULL;
+
+    // Create our list of window pointers.
+    klist_t(WindowPtr)* windows = kl_init(WindowPtr);
+
+    // Allocate our ring of window start positions.
+    int* windowStarts = (int*) calloc(WINDOW_SPAN / STEP_SPAN, sizeof(int));
+
+    // The statistics of the tiles in the window.
+    WindowStatistics* statistics = init_window_statistics(WINDOW_SPAN / HAP_SPAN);
+
+    // Windows are taken from a pool. The pool lives until the last window in the list is destroyed.
+    WindowPool* pool = init_window_pool();
+    Window* currentWindow = take_window(pool);
+    Window* nextWindow = take_window(pool);
+
+    // While there is a window to process.
+    while (get_next_span_window(parser, encoder, currentWindow, nextWindow, windowStarts, statistics, WINDOW_SPAN, HAP_SPAN, STEP_SPAN)) {
+        *kl_pushp(WindowPtr, windows) = currentWindow;
+        currentWindow = nextWindow;
+        nextWindow = take_window(pool);
+    }
+
+    // The last two windows are unused, and not added to list.
+    release_window_pool(pool);
+    destroy_window(currentWindow);
+    destroy_window(nextWindow);
+    free(windowStarts);
+    destroy_window_statistics(statistics);
+    INSTRUMENT_REPORT();
+
+    return windows;
+
+}
+
+WindowIterator* init_window_iterator(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+
+    WindowIterator* iterator = (WindowIterator*) calloc(1, sizeof(WindowIterator));
+    iterator -> parser = parser;
+    iterator -> encoder = encoder;
+    iterator -> WINDOW_SIZE = WINDOW_SIZE;
+    iterator -> HAP_SIZE = HAP_SIZE;
+    iterator -> OFFSET_SIZE = OFFSET_SIZE;
+
+    // Allocate our list of start locations.
+    iterator -> startLoci = (int*) calloc((WINDOW_SIZE - OFFSET_SIZE) / OFFSET_SIZE + 1, sizeof(int));
+    iterator -> statistics = init_window_statistics(WINDOW_SIZE);
+
+    // Only two windows are ever allocated.
+    iterator -> pool = init_window_pool();
+    iterator -> currentWindow = take_window(iterator -> pool);
+    iterator -> nextWindow = take_window(iterator -> pool);
+    iterator -> hasReturnedWindow = false;
+
+    return iterator;
+
+}
+
+WindowIterator* init_span_window_iterator(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN) {
+
+    if (!is_valid_span(WINDOW_SPAN, HAP_SPAN, STEP_SPAN))
+        return NULL;
+
+    WindowIterator* iterator = (WindowIterator*) calloc(1, sizeof(WindowIterator));
+    iterator -> parser = parser;
+    iterator -> encoder = encoder;
+    iterator -> WINDOW_SPAN = WINDOW_SPAN;
+    iterator -> HAP_SPAN = HAP_SPAN;
+    iterator -> STEP_SPAN = STEP_SPAN;
+
+    // The ring of window start positions takes the place of startLoci.
+    iterator -> startLoci = (int*) calloc(WINDOW_SPAN / STEP_SPAN, sizeof(int));
+    iterator -> statistics = init_window_statistics(WINDOW_SPAN / HAP_SPAN);
+
+    // Only two windows are ever allocated.
+    iterator -> pool = init_window_pool();
+    iterator -> currentWindow = take_window(iterator -> pool);
+    iterator -> nextWindow = take_window(iterator -> pool);
+    iterator -> hasReturnedWindow = false;
+
+    return iterator;
+
+}
+
+Window* get_next_window_from_iterator(WindowIterator* iterator) {
+
+    // The prepared next window becomes the current window, and the returned window is recycled.
+    if (iterator -> hasReturnedWindow) {
+        Window* temp = iterator -> currentWindow;
+        iterator -> currentWindow = iterator -> nextWindow;
+        iterator -> nextWindow = temp;
+    }
+    reset_window(iterator -> nextWindow);
+
+    bool isFilled;
+    if (iterator -> WINDOW_SPAN > 0)
+        isFilled = get_next_span_window(iterator -> parser, iterator -> encoder, iterator -> currentWindow, iterator -> nextWindow, iterator -> startLoci, iterator -> statistics, iterator -> WINDOW_SPAN, iterator -> HAP_SPAN, iterator -> STEP_SPAN);
+    else
+        isFilled = get_next_window(iterator -> parser, iterator -> encoder, iterator -> currentWindow, iterator -> nextWindow, iterator -> startLoci, iterator -> statistics, iterator -> WINDOW_SIZE, iterator -> HAP_SIZE, iterator -> OFFSET_SIZE);
+    if (!isFilled)
+        return NULL;
+    iterator -> hasReturnedWindow = true;
+    return iterator -> currentWindow;
+
+}
+
+void destroy_window_iterator(WindowIterator* iterator) {
+    if (iterator == NULL)
+        return;
+    // The pool is freed with its last window.
+    release_window_pool(iterator -> pool);
+    destroy_window(iterator -> currentWindow);
+    destroy_window(iterator -> nextWindow);
+    free(iterator -> startLoci);
+    destroy_window_statistics(iterator -> statistics);
+    free(iterator);
+}
+
+int slide_through_genome_with_callback(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE, void (*process_window)(Window* window, void* arg), void* arg) {
+
+    // Pass each window to the consumer as soon as it is complete.
+    WindowIterator* iterator = init_window_iterator(parser, encoder, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
+    int numWindows = 0;
+    Window* window;
+    while ((window = get_next_window_from_iterator(iterator)) != NULL) {
+        process_window(window, arg);
+        numWindows++;
+    }
+    destroy_window_iterator(iterator);
+    INSTRUMENT_REPORT();
+
+    return numWindows;
+
+}
+
+// The fixed-size part of a checkpoint file. The rings follow it. Checkpoints are read
+//  back by the same build, so the structures are written as they are in memory.
+typedef struct {
+    char magic[4];
+    int version;
+    // The sizes of the windows and the number of samples, to check the resumed run.
+    int WINDOW_SIZE;
+    int HAP_SIZE;
+    int OFFSET_SIZE;
+    int WINDOW_SPAN;
+    int HAP_SPAN;
+    int STEP_SPAN;
+    int numSamples;
+    // The size and modification time of the input file, to check it is the one checkpointed.
+    long fileSize;
+    long fileModified;
+    // The position of the next record. See tell_vcf_genotype_parser.
+    long offset;
+    unsigned long long virtualOffset;
+    // The offset of the output after the last window processed.
+    long outputOffset;
+    // The counters of the next window.
+    int windowNum;
+    int windowNumOnChromosome;
+    int numLoci;
+    int startLocus;
+    // Set if the encoder's chromosome is the next record's.
+    bool isChromosomeCurrent;
+    // Set if the last record read is on the next record's chromosome.
+    bool isSameChromosome;
+    // The lengths of the encoder's chromosome, the startLoci ring, and the statistics ring.
+    int chromosomeLength;
+    int numStartLoci;
+    int numHaplotypes;
+} CheckpointHeader;
+
+// Reads the size and modification time of a parser's file.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  long* fileSize -> Set to the size of the file in bytes.
+//  long* fileModified -> Set to the last modification time of the file.
+// Returns:
+//  bool, False if the file could not be found.
+static bool stat_input_file(VCFGenotypeParser* parser, long* fileSize, long* fileModified) {
+    struct stat fileInfo;
+    if (stat(ks_str(parser -> file_name), &fileInfo) != 0)
+        return false;
+    *fileSize = fileInfo.st_size;
+    *fileModified = fileInfo.st_mtime;
+    return true;
+}
+
+// Returns the length of an iterator's startLoci ring.
+static int num_start_loci(WindowIterator* iterator) {
+    return iterator -> WINDOW_SPAN > 0 ? iterator -> WINDOW_SPAN / iterator -> STEP_SPAN : (iterator -> WINDOW_SIZE - iterator -> OFFSET_SIZE) / iterator -> OFFSET_SIZE + 1;
+}
+
+bool save_window_checkpoint(WindowIterator* iterator, char* file_name, long outputOffset) {
+
+    // The window after the last returned window is the next one filled.
+    Window* window = iterator -> hasReturnedWindow ? iterator -> nextWindow : iterator -> currentWindow;
+    VCFGenotypeParser* parser = iterator -> parser;
+    HaplotypeEncoder* encoder = iterator -> encoder;
+    WindowStatistics* statistics = iterator -> statistics;
+
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(CheckpointHeader));
+    if (!tell_vcf_genotype_parser(parser, &(header.offset), &(header.virtualOffset)) || !stat_input_file(parser, &(header.fileSize), &(header.fileModified)))
+        return false;
+    memcpy(header.magic, CHECKPOINT_MAGIC, 4);
+    header.version = CHECKPOINT_VERSION;
+    header.WINDOW_SIZE = iterator -> WINDOW_SIZE;
+    header.HAP_SIZE = iterator -> HAP_SIZE;
+    header.OFFSET_SIZE = iterator -> OFFSET_SIZE;
+    header.WINDOW_SPAN = iterator -> WINDOW_SPAN;
+    header.HAP_SPAN = iterator -> HAP_SPAN;
+    header.STEP_SPAN = iterator -> STEP_SPAN;
+    header.numSamples = parser -> num_samples;
+    header.outputOffset = outputOffset;
+    header.windowNum = window -> windowNum;
+    header.windowNumOnChromosome = window -> windowNumOnChromosome;
+    header.numLoci = window -> numLoci;
+    header.startLocus = window -> startLocus;
+    header.isChromosomeCurrent = encoder -> isChromosomeCurrent;
+    header.isSameChromosome = parser -> contigId == parser -> nextContigId;
+    header.chromosomeLength = ks_len(encoder -> chromosome);
+    header.numStartLoci = num_start_loci(iterator);
+    header.numHaplotypes = statistics -> numHaplotypes;
+
+    // Write a temporary file and move it over the last checkpoint, so a crash leaves one intact.
+    kstring_t tempName = { 0, 0, NULL };
+    kputs(file_name, &tempName);
+    kputs(".tmp", &tempName);
+    FILE* out = fopen(ks_str(&tempName), "wb");
+    if (out == NULL) {
+        free(ks_str(&tempName));
+        return false;
+    }
+    bool isWritten = fwrite(&header, sizeof(CheckpointHeader), 1, out) == 1
+                    && fwrite(ks_str(encoder -> chromosome), 1, header.chromosomeLength, out) == header.chromosomeLength
+                    && fwrite(iterator -> startLoci, sizeof(int), header.numStartLoci, out) == header.numStartLoci;
+    for (int i = 0; i < statistics -> numHaplotypes && isWritten; i++)
+        isWritten = fwrite(&(statistics -> haplotypes[(statistics -> first + i) % statistics -> maxHaplotypes]), sizeof(HaplotypeStatistics), 1, out) == 1;
+    isWritten = isWritten && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    isWritten = fclose(out) == 0 && isWritten;
+    isWritten = isWritten && rename(ks_str(&tempName), file_name) == 0;
+    if (!isWritten)
+        remove(ks_str(&tempName));
+    free(ks_str(&tempName));
+
+    return isWritten;
+
+}
+
+bool resume_window_iterator(WindowIterator* iterator, char* file_name, long* outputOffset) {
+
+    VCFGenotypeParser* parser = iterator -> parser;
+    HaplotypeEncoder* encoder = iterator -> encoder;
+    WindowStatistics* statistics = iterator -> statistics;
+
+    FILE* in = fopen(file_name, "rb");
+    if (in == NULL)
+        return false;
+
+    // Read the whole checkpoint before anything is changed.
+    CheckpointHeader header;
+    long fileSize, fileModified;
+    bool isRead = fread(&header, sizeof(CheckpointHeader), 1, in) == 1
+                    && memcmp(header.magic, CHECKPOINT_MAGIC, 4) == 0 && header.version == CHECKPOINT_VERSION
+                    && header.WINDOW_SIZE == iterator -> WINDOW_SIZE && header.HAP_SIZE == iterator -> HAP_SIZE && header.OFFSET_SIZE == iterator -> OFFSET_SIZE
+                    && header.WINDOW_SPAN == iterator -> WINDOW_SPAN && header.HAP_SPAN == iterator -> HAP_SPAN && header.STEP_SPAN == iterator -> STEP_SPAN
+                    && header.numSamples == parser -> num_samples && header.chromosomeLength >= 0
+                    && stat_input_file(parser, &fileSize, &fileModified) && header.fileSize == fileSize && header.fileModified == fileModified
+                    && header.numStartLoci == num_start_loci(iterator)
+                    && header.numHaplotypes >= 0 && header.numHaplotypes <= statistics -> maxHaplotypes;
+    char* chromosome = NULL;
+    int* startLoci = NULL;
+    HaplotypeStatistics* haplotypes = NULL;
+    if (isRead) {
+        chromosome = (char*) malloc(header.chromosomeLength + 1);
+        startLoci = (int*) malloc((header.numStartLoci + 1) * sizeof(int));
+        haplotypes = (HaplotypeStatistics*) malloc((header.numHaplotypes + 1) * sizeof(HaplotypeStatistics));
+        isRead = fread(chromosome, 1, header.chromosomeLength, in) == header.chromosomeLength
+                    && fread(startLoci, sizeof(int), header.numStartLoci, in) == header.numStartLoci
+                    && fread(haplotypes, sizeof(HaplotypeStatistics), header.numHaplotypes, in) == header.numHaplotypes;
+    }
+    fclose(in);
+
+    // The iterator must not have started, and the parser must reach the record.
+    isRead = isRead && !(iterator -> hasReturnedWindow) && resume_vcf_genotype_parser(parser, header.offset, header.virtualOffset);
+
+    if (isRead) {
+        // Contig ids start over in a new parser. Only their equality is used.
+        parser -> contigId = header.isSameChromosome ? parser -> nextContigId : -1;
+        encoder -> chromosome -> l = 0;
+        kputsn(chromosome, header.chromosomeLength, encoder -> chromosome);
+        encoder -> isChromosomeCurrent = header.isChromosomeCurrent;
+        Window* window = iterator -> currentWindow;
+        window -> windowNum = header.windowNum;
+        window -> windowNumOnChromosome = header.windowNumOnChromosome;
+        window -> numLoci = header.numLoci;
+        window -> startLocus = header.startLocus;
+        if (header.numStartLoci > 0)
+            memcpy(iterator -> startLoci, startLoci, header.numStartLoci * sizeof(int));
+        remove_haplotype_statistics(statistics, statistics -> numHaplotypes);
+        for (int i = 0; i < header.numHaplotypes; i++)
+            push_haplotype_statistics(statistics, &(haplotypes[i]));
+        *outputOffset = header.outputOffset;
+    }
+
+    free(chromosome);
+    free(startLoci);
+    free(haplotypes);
+    return isRead;
+
+}
+
+int slide_through_genome_with_checkpoints(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE, void (*process_window)(Window* window, void* arg), void* arg, FILE* output, char* checkpoint_file, int checkpointInterval, bool isResume) {
+
+    // Keep the blocks the checkpoints point into. Must come before pipelining.
+    enable_checkpointing(parser);
+    WindowIterator* iterator = init_window_iterator(parser, encoder, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
+
+    // Restart from the checkpoint. Without one, the run starts over.
+    long outputOffset = 0;
+    if (isResume) {
+        if (access(checkpoint_file, F_OK) == 0 && !resume_window_iterator(iterator, checkpoint_file, &outputOffset)) {
+            destroy_window_iterator(iterator);
+            return -1;
+        }
+        // Drop the output of the windows after the checkpoint.
+        if (output != NULL && (fflush(output) != 0 || ftruncate(fileno(output), outputOffset) != 0 || fseeko(output, outputOffset, SEEK_SET) != 0)) {
+            destroy_window_iterator(iterator);
+            return -1;
+        }
+    }
+    enable_locus_pipelining(parser);
+
+    int numWindows = 0;
+    Window* window;
+    while ((window = get_next_window_from_iterator(iterator)) != NULL) {
+        process_window(window, arg);
+        numWindows++;
+        if (checkpointInterval > 0 && numWindows % checkpointInterval == 0) {
+            // The output must hold every window before the checkpoint.
+            if (output != NULL) {
+                fflush(output);
+                fsync(fileno(output));
+                outputOffset = ftello(output);
+            }
+            // A failed checkpoint leaves the last one in place.
+            save_window_checkpoint(iterator, checkpoint_file, outputOffset);
+        }
+    }
+    destroy_window_iterator(iterator);
+
+    // The run is complete, so there is nothing to resume.
+    if (checkpointInterval > 0)
+        remove(checkpoint_file);
+    INSTRUMENT_REPORT();
+
+    return numWindows;
+
+}
+
+// The window state of one configuration in a single-pass scan.
+typedef struct {
+    WindowConfiguration configuration;
+    // The encoder shared by the configurations with the same HAP_SIZE.
+    HaplotypeEncoder* encoder;
+    // The start loci of the next windows within the current window.
+    int* startLoci;
+    // The statistics of the haplotypes in the current window.
+    WindowStatistics* statistics;
+    WindowPool* pool;
+    Window* currentWindow;
+    Window* nextWindow;
+    // The number of haplotypes in currentWindow, or -1 before its first haplotype.
+    int numHapsInWindow;
+    // The completed windows.
+    klist_t(WindowPtr)* windows;
+} ConfigurationScan;
+
+// Adds the encoder's haplotype to a configuration's window. Follows get_next_window one
+//  haplotype at a time, so the windows are the same as slide_through_genome's.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser. Its last locus is the haplotype's last.
+//  ConfigurationScan* scan -> The configuration's window state.
+//  bool isSameChromosome -> The value get_next_haplotype would have returned for the haplotype.
+// Returns:
+//  void.
+static void add_haplotype_to_scan(VCFGenotypeParser* parser, ConfigurationScan* scan, bool isSameChromosome) {
+
+    WindowConfiguration* configuration = &(scan -> configuration);
+
+    // The window lies on the chromosome of its first haplotype.
+    if (scan -> numHapsInWindow < 0)
+        scan -> numHapsInWindow = begin_window(scan -> currentWindow, scan -> statistics, parser -> contigId, ks_str(scan -> encoder -> chromosome), configuration -> HAP_SIZE);
+
+    add_haplotype_to_window(scan -> encoder, scan -> currentWindow, scan -> startLoci, scan -> statistics, scan -> numHapsInWindow, configuration -> WINDOW_SIZE, configuration -> OFFSET_SIZE);
+    scan -> numHapsInWindow++;
+
+    // The window is not filled yet.
+    if (scan -> numHapsInWindow < configuration -> WINDOW_SIZE && isSameChromosome)
+        return;
+
+    end_window(scan -> encoder, scan -> currentWindow, scan -> nextWindow, scan -> startLoci, scan -> statistics, isSameChromosome, configuration -> WINDOW_SIZE, configuration -> HAP_SIZE, configuration -> OFFSET_SIZE);
+    *kl_pushp(WindowPtr, scan -> windows) = scan -> currentWindow;
+    scan -> currentWindow = scan -> nextWindow;
+    scan -> nextWindow = take_window(scan -> pool);
+    scan -> numHapsInWindow = -1;
+
+}
+
+klist_t(WindowPtr)** slide_through_genome_with_configurations(VCFGenotypeParser* parser, WindowConfiguration* configurations, int numConfigurations) {
+
+    // If EOF, there are no windows to process.
+    if (parser -> isEOF || numConfigurations < 1)
+        return NULL;
+
+    // One encoder for each distinct HAP_SIZE.
+    HaplotypeEncoder** encoders = (HaplotypeEncoder**) calloc(numConfigurations, sizeof(HaplotypeEncoder*));
+    int* hapSizes = (int*) calloc(numConfigurations, sizeof(int));
+    int numEncoders = 0;
+
+    // The window state of each configuration.
+    ConfigurationScan* scans = (ConfigurationScan*) calloc(numConfigurations, sizeof(ConfigurationScan));
+    for (int i = 0; i < numConfigurations; i++) {
+        WindowConfiguration* configuration = &(configurations[i]);
+        int j;
+        for (j = 0; j < numEncoders && hapSizes[j] != configuration -> HAP_SIZE; j++);
+        if (j == numEncoders) {
+            encoders[j] = init_haplotype_encoder(parser -> num_samples, false);
+            hapSizes[j] = configuration -> HAP_SIZE;
+            numEncoders++;
+        }
+        ConfigurationScan* scan = &(scans[i]);
+        scan -> configuration = *configuration;
+        scan -> encoder = encoders[j];
+        scan -> startLoci = (int*) calloc((configuration -> WINDOW_SIZE - configuration -> OFFSET_SIZE) / configuration -> OFFSET_SIZE + 1, sizeof(int));
+        scan -> statistics = init_window_statistics(configuration -> WINDOW_SIZE);
+        scan -> pool = init_window_pool();
+        scan -> currentWindow = take_window(scan -> pool);
+        scan -> nextWindow = take_window(scan -> pool);
+        scan -> numHapsInWindow = -1;
+        scan -> windows = kl_init(WindowPtr);
+    }
+
+    // Each locus is read once and added to every encoder.
+    GENOTYPE* genotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    int position, numAlleles;
+    for (int j = 0; j < numEncoders; j++)
+        start_haplotype(parser, encoders[j]);
+    while (!(parser -> isEOF)) {
+        get_next_locus(parser, NULL, &position, &numAlleles, &genotypes);
+        bool isSameChromosome = !(parser -> isEOF) && parser -> contigId == parser -> nextContigId;
+        for (int j = 0; j < numEncoders; j++) {
+            add_shared_locus(parser, encoders[j], genotypes, position, numAlleles, true);
+            if (encoders[j] -> numLoci < hapSizes[j] && isSameChromosome)
+                continue;
+            // The haplotype is complete. Pass it to each configuration with its HAP_SIZE.
+            bool isFullHaplotype = finish_haplotype(parser, encoders[j]) && encoders[j] -> numLoci == hapSizes[j];
+            for (int i = 0; i < numConfigurations; i++)
+                if (scans[i].encoder == encoders[j])
+                    add_haplotype_to_scan(parser, &(scans[i]), isFullHaplotype);
+            if (!(parser -> isEOF))
+                start_haplotype(parser, encoders[j]);
+        }
+    }
+
+    // Free the state. The pools are freed with the last windows in the lists.
+    klist_t(WindowPtr)** windows = (klist_t(WindowPtr)**) calloc(numConfigurations, sizeof(klist_t(WindowPtr)*));
+    for (int i = 0; i < numConfigurations; i++) {
+        windows[i] = scans[i].windows;
+        release_window_pool(scans[i].pool);
+        destroy_window(scans[i].currentWindow);
+        destroy_window(scans[i].nextWindow);
+        free(scans[i].startLoci);
+        destroy_window_statistics(scans[i].statistics);
+    }
+    for (int j = 0; j < numEncoders; j++)
+        destroy_haplotype_encoder(encoders[j]);
+    free(encoders);
+    free(hapSizes);
+    free(scans);
+    free(genotypes);
+    INSTRUMENT_REPORT();
+
+    return windows;
+
+}
+
+// The work shared by the threads of slide_through_genome_parallel.
+typedef struct {
+    char* file_name;
+    int WINDOW_SIZE;
+    int HAP_SIZE;
+    int OFFSET_SIZE;
+    // The chromosomes to process.
+    ChromosomeRange* ranges;
+    int numChromosomes;
+    // The windows of each chromosome.
+    klist_t(WindowPtr)** windows;
+    // The next chromosome to process.
+    int nextChromosome;
+    // Protects nextChromosome.
+    pthread_mutex_t lock;
+} ChromosomeWork;
+
+// The routine run by each thread. Slides through chromosomes until there are none left.
+// Accepts:
+//  void* arg -> The ChromosomeWork.
+// Returns:
+//  void*, Always NULL.
+static void* slide_through_chromosomes(void* arg) {
+    ChromosomeWork* work = (ChromosomeWork*) arg;
+    while (true) {
+        // Claim the next chromosome.
+        pthread_mutex_lock(&(work -> lock));
+        int chromosome = work -> nextChromosome++;
+        pthread_mutex_unlock(&(work -> lock));
+        if (chromosome >= work -> numChromosomes)
+            break;
+
+        // Each chromosome gets its own parser and encoder.
+        VCFGenotypeParser* parser = init_vcf_genotype_parser(work -> file_name, 0);
+        enable_genotype_packing(parser);
+        seek_vcf_genotype_parser(parser, work -> ranges[chromosome].startOffset, work -> ranges[chromosome].endOffset);
+        HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+        work -> windows[chromosome] = slide_windows(parser, encoder, work -> WINDOW_SIZE, work -> HAP_SIZE, work -> OFFSET_SIZE);
+        destroy_vcf_genotype_parser(parser);
+        destroy_haplotype_encoder(encoder);
+    }
+    return NULL;
+}
+
+klist_t(WindowPtr)* slide_through_genome_parallel(char* file_name, int numThreads, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE) {
+
+    // Split the file by chromosome.
+    ChromosomeWork work;
+    work.ranges = scan_chromosome_ranges(file_name, numThreads, &(work.numChromosomes));
+    if (work.ranges == NULL)
+        return NULL;
+    work.file_name = file_name;
+    work.WINDOW_SIZE = WINDOW_SIZE;
+    work.HAP_SIZE = HAP_SIZE;
+    work.OFFSET_SIZE = OFFSET_SIZE;
+    work.windows = (klist_t(WindowPtr)**) calloc(work.numChromosomes, sizeof(klist_t(WindowPtr)*));
+    work.nextChromosome = 0;
+    pthread_mutex_init(&(work.lock), NULL);
+
+    // Process the chromosomes.
+    if (numThreads < 1)
+        numThreads = 1;
+    pthread_t* threads = (pthread_t*) calloc(numThreads, sizeof(pthread_t));
+    for (int i = 0; i < numThreads; i++)
+        pthread_create(&threads[i], NULL, slide_through_chromosomes, &work);
+    for (int i = 0; i < numThreads; i++)
+        pthread_join(threads[i], NULL);
+    free(threads);
+    pthread_mutex_destroy(&(work.lock));
+
+    // Merge the windows in file order and number them as a serial run would.
+    klist_t(WindowPtr)* windows = kl_init(WindowPtr);
+    int windowNum = 1;
+    for (int i = 0; i < work.numChromosomes; i++) {
+        if (work.windows[i] != NULL) {
+            for (kliter_t(WindowPtr)* it = kl_begin(work.windows[i]); it != kl_end(work.windows[i]); it = kl_next(it)) {
+                kl_val(it) -> windowNum = windowNum++;
+                *kl_pushp(WindowPtr, windows) = kl_val(it);
+                // The window now belongs to the merged list.
+                kl_val(it) = NULL;
+            }
+            kl_destroy(WindowPtr, work.windows[i]);
+        }
+        free(ks_str(work.ranges[i].chromosome)); free(work.ranges[i].chromosome);
+    }
+    free(work.windows);
+    free(work.ranges);
+    INSTRUMENT_REPORT();
+
+    return windows;
+
+}
+
+// Used to test sliding window. Left out when linked into the benchmark.
+
+#ifndef NO_DRIVER
 
 void print_window_info(Window* window) {
     printf("Window Number: %d\n", window -> windowNum);
@@ -127,15 +901,21 @@ void print_window_info(Window* window) {
     printf("Start Position: %d\n", window -> startLocus);
     printf("End Position: %d\n", window -> endLocus);
     printf("Number of Loci: %d\n", window -> numLoci);
+    printf("Distinct Haplotypes: %ld\n", window -> numDistinctHaplotypes);
+    printf("Missing Haplotypes: %ld\n", window -> numMissingHaplotypes);
+    printf("Haplotype Homozygosity: %f\n", window -> haplotypeHomozygosity);
     printf("\n");
 }
 
 int main() {
 
-    int WINDOW_SIZE = 10, HAP_SIZE = 100, OFFSET_SIZE = 1;
+    int WINDOW_SIZE = 10, HAP_SIZE = 100, OFFSET_SIZE = 1, NUM_THREADS = 4;
 
-    VCFGenotypeParser* parser = init_vcf_genotype_parser("sliding_window_test.vcf.gz");
-    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples);
+    VCFGenotypeParser* parser = init_vcf_genotype_parser("sliding_window_test.vcf.gz", NUM_THREADS);
+    enable_genotype_packing(parser);
+    enable_locus_pipelining(parser);
+    HaplotypeEncoder* encoder = init_haplotype_encoder(parser -> num_samples, false);
+    enable_sharded_encoding(encoder, NUM_THREADS);
     
     klist_t(WindowPtr)* windows = slide_through_genome(parser, encoder, WINDOW_SIZE, HAP_SIZE, OFFSET_SIZE);
     
@@ -153,4 +933,6 @@ int main() {
 
     return 0;
 
-}
\ No newline at end of file
+}
+
+#endif
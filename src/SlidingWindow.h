@@ -13,6 +13,9 @@
 
 #include "HaplotypeEncoder.h"
 
+// Reports where the time went when built with make INSTRUMENT=1.
+#include "Instrumentation.h"
+
 // We are using klib list.
 #include "../klib/klist.h"
 
@@ -23,6 +26,8 @@
 KLIST_INIT(WindowPtr, Window*, destroy_w)
 
 // Method to slide through window and generate a list of windows.
+//  When instrumented, the report is written once the genome is done. So are the reports
+//  of slide_through_genome_with_callback and slide_through_genome_parallel.
 // Accepts:
 //  VCFGenotpyeParser* parser -> The VCF file parser to read.
 //  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
@@ -33,4 +38,177 @@ KLIST_INIT(WindowPtr, Window*, destroy_w)
 //  klist_t(WindowPtr)*, A pointer to a klist of window pointers.
 klist_t(WindowPtr)* slide_through_genome(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE);
 
+// Slides windows of a fixed number of bp through the genome in one pass. Windows on a
+//  chromosome start at 1, 1 + STEP_SPAN, 1 + 2 * STEP_SPAN, ..., and windows without loci
+//  are never created. A window's startLocus and endLocus are the bounds of its span.
+//  Its haplotypes are the loci in each tile of HAP_SPAN bp from position 1, so a window
+//  has the same statistics whatever the STEP_SPAN.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
+//  int WINDOW_SPAN -> The number of bp in a window.
+//  int HAP_SPAN -> The number of bp in a haplotype.
+//  int STEP_SPAN -> The number of bp between the starts of consecutive windows. Must be a
+//                      multiple of HAP_SPAN that divides WINDOW_SPAN.
+// Returns:
+//  klist_t(WindowPtr)*, A pointer to a klist of window pointers, or NULL if EOF or the spans are invalid.
+klist_t(WindowPtr)* slide_through_genome_by_span(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN);
+
+// Streams windows one at a time instead of materializing the list.
+//  Only two windows are ever allocated, so memory does not grow with the genome.
+typedef struct {
+    VCFGenotypeParser* parser;
+    HaplotypeEncoder* encoder;
+    int WINDOW_SIZE;
+    int HAP_SIZE;
+    int OFFSET_SIZE;
+    // If positive, windows span WINDOW_SPAN bp of HAP_SPAN bp haplotypes and step by STEP_SPAN bp instead.
+    int WINDOW_SPAN;
+    int HAP_SPAN;
+    int STEP_SPAN;
+    // The start loci of the next windows within the current window.
+    int* startLoci;
+    // The statistics of the haplotypes in the current window.
+    WindowStatistics* statistics;
+    // Holds the two windows and their interned chromosome names.
+    WindowPool* pool;
+    // The window returned to the consumer.
+    Window* currentWindow;
+    // The window after currentWindow, set up by the overlap calculations.
+    Window* nextWindow;
+    // Set once currentWindow has been returned.
+    bool hasReturnedWindow;
+} WindowIterator;
+
+// Creates a WindowIterator.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
+//  int WINDOW_SIZE -> The number of haplotypes in a window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+// Returns:
+//  WindowIterator*, The created iterator.
+WindowIterator* init_window_iterator(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE);
+
+// Creates a WindowIterator over windows of a fixed span. See slide_through_genome_by_span.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
+//  int WINDOW_SPAN -> The number of bp in a window.
+//  int HAP_SPAN -> The number of bp in a haplotype.
+//  int STEP_SPAN -> The number of bp between the starts of consecutive windows.
+// Returns:
+//  WindowIterator*, The created iterator, or NULL if the spans are invalid.
+WindowIterator* init_span_window_iterator(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SPAN, int HAP_SPAN, int STEP_SPAN);
+
+// Get the next window from an iterator.
+// Accepts:
+//  WindowIterator* iterator -> The iterator.
+// Returns:
+//  Window*, The next window, or NULL when EOF. The window is owned by the iterator
+//              and is recycled on the next call.
+Window* get_next_window_from_iterator(WindowIterator* iterator);
+
+// Deallocate the memory occupied by an iterator.
+// Accepts:
+//  WindowIterator* iterator -> The iterator to destroy.
+// Returns:
+//  void.
+void destroy_window_iterator(WindowIterator* iterator);
+
+// Slides through the genome and passes each window to a callback as soon as it is complete.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
+//  int WINDOW_SIZE -> The number of haplotypes in a window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+//  void (*process_window)(Window* window, void* arg) -> Called on each window. The window is
+//                                                          recycled after the callback returns.
+//  void* arg -> Passed to process_window.
+// Returns:
+//  int, The number of windows processed.
+int slide_through_genome_with_callback(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE, void (*process_window)(Window* window, void* arg), void* arg);
+
+// The first bytes and the version of a checkpoint file.
+#define CHECKPOINT_MAGIC "SWCP"
+#define CHECKPOINT_VERSION 2
+
+// Saves what an iterator needs to continue after its last returned window: the position of
+//  the next record, the encoder's chromosome, the startLoci and statistics rings, and the
+//  counters of the next window. The size and modification time of the input file are saved
+//  too. The file is replaced atomically.
+// Accepts:
+//  WindowIterator* iterator -> The iterator.
+//  char* file_name -> The checkpoint file.
+//  long outputOffset -> The offset of the caller's output after the last returned window.
+// Returns:
+//  bool, False if EOF, the parser's position is not known, the input file could not be found,
+//          or the file could not be written.
+bool save_window_checkpoint(WindowIterator* iterator, char* file_name, long outputOffset);
+
+// Moves a new iterator to a checkpoint. The iterator, its parser, and its encoder must be
+//  created as they were for the checkpointed run, and no window may have been taken yet.
+// Accepts:
+//  WindowIterator* iterator -> The new iterator.
+//  char* file_name -> The checkpoint file.
+//  long* outputOffset -> Set to the output offset saved with the checkpoint.
+// Returns:
+//  bool, False if the file is missing or does not match the iterator, or the input file's size or
+//          modification time changed. The iterator is then unchanged.
+bool resume_window_iterator(WindowIterator* iterator, char* file_name, long* outputOffset);
+
+// Slides through the genome like slide_through_genome_with_callback, saving a checkpoint
+//  every checkpointInterval windows. The checkpoint is removed once the genome is done.
+//  Pipelines the parser after resuming, so the parser must not be pipelined yet.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  HaplotypeEncoder* encoder -> The encoder used to encode haplotypes.
+//  int WINDOW_SIZE -> The number of haplotypes in a window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+//  void (*process_window)(Window* window, void* arg) -> Called on each window.
+//  void* arg -> Passed to process_window.
+//  FILE* output -> The file process_window writes to, or NULL. Its offset is saved with each
+//                      checkpoint. On resume, it is truncated back to it, so it must be a regular file.
+//  char* checkpoint_file -> The checkpoint file.
+//  int checkpointInterval -> The number of windows between checkpoints. If 0, none are saved.
+//  bool isResume -> If set, continues from the checkpoint. Without one, the run starts over.
+// Returns:
+//  int, The number of windows processed by this run, or -1 if the checkpoint could not be resumed.
+int slide_through_genome_with_checkpoints(VCFGenotypeParser* parser, HaplotypeEncoder* encoder, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE, void (*process_window)(Window* window, void* arg), void* arg, FILE* output, char* checkpoint_file, int checkpointInterval, bool isResume);
+
+// The sizes of the windows of one configuration.
+typedef struct {
+    int WINDOW_SIZE;
+    int HAP_SIZE;
+    int OFFSET_SIZE;
+} WindowConfiguration;
+
+// Slides the windows of several configurations through the genome in one pass. Each locus
+//  is read once and added to one encoder per distinct HAP_SIZE, and each configuration
+//  keeps its own windows. The windows of a configuration are the same as slide_through_genome's.
+// Accepts:
+//  VCFGenotpyeParser* parser -> The VCF file parser to read.
+//  WindowConfiguration* configurations -> The configurations.
+//  int numConfigurations -> The number of configurations.
+// Returns:
+//  klist_t(WindowPtr)**, An array with a klist of window pointers for each configuration,
+//                          or NULL if EOF. The caller frees the array and each list.
+klist_t(WindowPtr)** slide_through_genome_with_configurations(VCFGenotypeParser* parser, WindowConfiguration* configurations, int numConfigurations);
+
+// Slides through each chromosome on its own thread. Windows never cross chromosomes, so
+//  each thread has a private parser, encoder, and startLoci ring. The results are identical
+//  to a serial run of slide_through_genome.
+// Accepts:
+//  char* file_name -> The name of the VCF file.
+//  int numThreads -> The number of chromosomes to process concurrently.
+//  int WINDOW_SIZE -> The number of haplotypes in a window.
+//  int HAP_SIZE -> The number of loci in a haplotype.
+//  int OFFSET_SIZE -> The number of haplotypes in the offset.
+// Returns:
+//  klist_t(WindowPtr)*, A pointer to a klist of window pointers, or NULL if the file does not exist.
+klist_t(WindowPtr)* slide_through_genome_parallel(char* file_name, int numThreads, int WINDOW_SIZE, int HAP_SIZE, int OFFSET_SIZE);
+
 #endif
\ No newline at end of file
@@ -6,30 +6,708 @@
 
 #include <stdio.h>
 
+#include <string.h>
+
+#include <limits.h>
+
+#include <ctype.h>
+
+#include <fcntl.h>
+
+#include <unistd.h>
+
+#include <sys/mman.h>
+
+#include <sys/stat.h>
+
 #include "VCFGenotypeParser.h"
 
-VCFGenotypeParser* init_vcf_genotype_parser(char* file_name) {
+#include "Instrumentation.h"
+
+// Maps a sample name to its column.
+KHASH_MAP_INIT_STR(sampleColumn, int)
+
+// SSE2 is part of x86-64. AVX2 kernels are compiled for the target
+//  and only called when the CPU supports them.
+#if defined(__x86_64__) || defined(__SSE2__)
+#include <immintrin.h>
+#define USE_SSE2
+#if defined(__GNUC__)
+#define USE_AVX2
+#endif
+#endif
+
+// Finds the next tab in a record.
+// Accepts:
+//  char* start -> Where to start searching.
+//  char* end -> The end of the record.
+// Returns:
+//  char*, A pointer to the tab, or end if there are no more tabs.
+static inline char* find_tab(char* start, char* end) {
+    // Most fields are short, so check the first few characters before scanning in bulk.
+    for (int i = 0; i < 4 && start < end; i++, start++)
+        if (*start == '\t')
+            return start;
+#ifdef USE_SSE2
+    const __m128i tabs = _mm_set1_epi8('\t');
+    for (; start + 16 <= end; start += 16) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*) start), tabs));
+        if (mask != 0)
+            return start + __builtin_ctz(mask);
+    }
+#endif
+    for (; start < end; start++)
+        if (*start == '\t')
+            return start;
+    return end;
+}
+
+// Skips a number of tab-separated fields.
+// Accepts:
+//  char* start -> The start of the first field to skip.
+//  char* end -> The end of the record.
+//  int numFields -> The number of fields to skip.
+// Returns:
+//  char*, The start of the field after the skipped fields, or end if the record is too short.
+static inline char* skip_fields(char* start, char* end, int numFields) {
+#ifdef USE_SSE2
+    // Count the tabs 16 characters at a time.
+    const __m128i tabs = _mm_set1_epi8('\t');
+    while (numFields > 0 && start + 16 <= end) {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*) start), tabs));
+        int numTabs = __builtin_popcount(mask);
+        if (numTabs >= numFields) {
+            // Clear the tabs before the one ending the last field.
+            for (int i = 1; i < numFields; i++)
+                mask &= mask - 1;
+            return start + __builtin_ctz(mask) + 1;
+        }
+        numFields -= numTabs;
+        start += 16;
+    }
+#endif
+    for (; numFields > 0 && start < end; start++)
+        if (*start == '\t')
+            numFields--;
+    return start;
+}
+
+// Parses the POS field. The last eight digits are converted at once.
+// Accepts:
+//  char* start -> The start of the field.
+//  char* fieldEnd -> The tab after the field.
+//  char* end -> The end of the record. The characters before it may be read past the field.
+//  int* position -> Set to the position.
+// Returns:
+//  bool, False if the field is empty, holds a character that is not a digit, or is larger than INT_MAX.
+static inline bool parse_position(char* start, char* fieldEnd, char* end, int* position) {
+    long numDigits = fieldEnd - start;
+    if (numDigits <= 0 || numDigits > 10)
+        return false;
+    long long value = 0;
+    // The digits before the last eight.
+    for (; numDigits > 8; numDigits--, start++) {
+        if (!IS_DIGIT(*start))
+            return false;
+        value = 10 * value + (*start - '0');
+    }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (start + 8 <= end) {
+        unsigned long long chunk;
+        memcpy(&chunk, start, 8);
+        // The first digit is in the low byte. Drop the characters after the field and pad the front with zeros.
+        if (numDigits < 8)
+            chunk = (chunk << (8 * (8 - numDigits))) | (0x3030303030303030ULL >> (8 * numDigits));
+        // Each byte must be 0x30 to 0x39. Adding 6 carries into the high nibble past 0x39.
+        if ((chunk & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL || ((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) != 0x3030303030303030ULL)
+            return false;
+        // Combine pairs of digits, then pairs of pairs, then the two halves.
+        chunk = ((chunk & 0x0F0F0F0F0F0F0F0FULL) * 2561) >> 8;
+        chunk = ((chunk & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+        chunk = ((chunk & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+        value = value * 100000000 + chunk;
+        start = fieldEnd;
+    }
+#endif
+    for (; start < fieldEnd; start++) {
+        if (!IS_DIGIT(*start))
+            return false;
+        value = 10 * value + (*start - '0');
+    }
+    if (value > INT_MAX)
+        return false;
+    *position = (int) value;
+    return true;
+}
+
+// Counts the alleles of a record from its ALT field, the reference allele and one per comma.
+// Accepts:
+//  char* start -> The start of the ALT field.
+//  char* end -> The end of the record.
+//  int* numAlleles -> Set to the number of alleles.
+// Returns:
+//  char*, A pointer to the tab after the field, or end if there are no more tabs.
+static inline char* count_alleles(char* start, char* end, int* numAlleles) {
+    int numCommas = 0;
+#ifdef USE_SSE2
+    const __m128i tabs = _mm_set1_epi8('\t'), commas = _mm_set1_epi8(',');
+    for (; start + 16 <= end; start += 16) {
+        __m128i chars = _mm_loadu_si128((__m128i*) start);
+        int isTab = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, tabs));
+        int isComma = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, commas));
+        if (isTab != 0) {
+            // Only count the commas before the tab.
+            *numAlleles = numCommas + __builtin_popcount(isComma & ((isTab & -isTab) - 1)) + 2;
+            return start + __builtin_ctz(isTab);
+        }
+        numCommas += __builtin_popcount(isComma);
+    }
+#endif
+    for (; start < end && *start != '\t'; start++)
+        numCommas += *start == ',';
+    *numAlleles = numCommas + 2;
+    return start;
+}
+
+// Counts a malformed record. Only the first is reported.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  long offset -> The offset of the record.
+//  char* field -> The name of the malformed field.
+// Returns:
+//  void.
+static void report_malformed_record(VCFGenotypeParser* parser, long offset, char* field) {
+    if (parser -> numMalformedRecords++ == 0)
+        fprintf(stderr, "Malformed %s in the record at offset %ld of %s. Later malformed records are only counted.\n", field, offset, ks_str(parser -> file_name));
+}
+
+// Decodes a run of genotypes of the form "a|b\t" or "a/b\t", where a and b are single digits
+//  below numAlleles. The scalar version decodes one genotype at a time.
+// Accepts:
+//  char* start -> The start of the first genotype.
+//  char* end -> The end of the record.
+//  GENOTYPE* genotypes -> The array to fill.
+//  int count -> The maximum number of genotypes to decode.
+//  int numAlleles -> The number of alleles at the record.
+// Returns:
+//  int, The number of genotypes decoded. Stops at the first genotype not in the form,
+//      so out of range alleles are left to parse_genotype.
+static int decode_fixed_width_genotypes_scalar(char* start, char* end, GENOTYPE* genotypes, int count, int numAlleles) {
+    int numDecoded = 0;
+    for (; numDecoded < count && start + 4 <= end; numDecoded++, start += 4) {
+        if (!IS_DIGIT(start[0]) || !IS_SEPARATOR(start[1]) || !IS_DIGIT(start[2]) || start[3] != '\t')
+            break;
+        if (start[0] - '0' >= numAlleles || start[2] - '0' >= numAlleles)
+            break;
+        genotypes[numDecoded] = (GENOTYPE) (((start[0] - '0') << 4) | (start[2] - '0'));
+    }
+    return numDecoded;
+}
+
+#ifdef USE_SSE2
+// Decodes four genotypes at a time. See decode_fixed_width_genotypes_scalar.
+static int decode_fixed_width_genotypes_sse2(char* start, char* end, GENOTYPE* genotypes, int count, int numAlleles) {
+    // Digits at or above the bound are not alleles at the record, so they end the run.
+    const __m128i zeros = _mm_set1_epi8('0'), bound = _mm_set1_epi8(numAlleles < 10 ? numAlleles : 10), negatives = _mm_set1_epi8(-1);
+    const __m128i tabs = _mm_set1_epi8('\t'), pipes = _mm_set1_epi8('|'), slashes = _mm_set1_epi8('/');
+    const __m128i nibbles = _mm_set1_epi32(0x000F000F), lowBytes = _mm_set1_epi32(0xFF);
+    int numDecoded = 0;
+    for (; numDecoded + 4 <= count && start + 16 <= end; numDecoded += 4, start += 16) {
+        __m128i chars = _mm_loadu_si128((__m128i*) start);
+        // Alleles are in the bytes 0 and 2 of each 32-bit lane, separators in byte 1, and tabs in byte 3.
+        __m128i digits = _mm_sub_epi8(chars, zeros);
+        int isDigit = _mm_movemask_epi8(_mm_and_si128(_mm_cmpgt_epi8(digits, negatives), _mm_cmplt_epi8(digits, bound)));
+        int isSeparator = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, pipes), _mm_cmpeq_epi8(chars, slashes)));
+        int isTab = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, tabs));
+        if ((isDigit & 0x5555) != 0x5555 || (isSeparator & 0x2222) != 0x2222 || (isTab & 0x8888) != 0x8888)
+            break;
+        // Move the left allele into the high nibble and the right allele into the low nibble of byte 0.
+        __m128i alleles = _mm_and_si128(digits, nibbles);
+        __m128i encoded = _mm_and_si128(_mm_or_si128(_mm_slli_epi32(alleles, 4), _mm_srli_epi32(alleles, 16)), lowBytes);
+        // Gather byte 0 of each lane.
+        encoded = _mm_packus_epi16(_mm_packs_epi32(encoded, encoded), encoded);
+        int packed = _mm_cvtsi128_si32(encoded);
+        memcpy(genotypes + numDecoded, &packed, 4);
+    }
+    return numDecoded + decode_fixed_width_genotypes_scalar(start, end, genotypes + numDecoded, count - numDecoded < 3 ? count - numDecoded : 3, numAlleles);
+}
+#endif
+
+#ifdef USE_AVX2
+// Decodes eight genotypes at a time. See decode_fixed_width_genotypes_scalar.
+//  Leaves the remaining genotypes to the caller, so SSE2 code never runs with dirty AVX registers.
+__attribute__((target("avx2")))
+static int decode_fixed_width_genotypes_avx2(char* start, char* end, GENOTYPE* genotypes, int count, int numAlleles) {
+    const __m256i zeros = _mm256_set1_epi8('0'), bound = _mm256_set1_epi8(numAlleles < 10 ? numAlleles : 10), negatives = _mm256_set1_epi8(-1);
+    const __m256i tabs = _mm256_set1_epi8('\t'), pipes = _mm256_set1_epi8('|'), slashes = _mm256_set1_epi8('/');
+    const __m256i nibbles = _mm256_set1_epi32(0x000F000F);
+    // Gathers byte 0 of each 32-bit lane into the first four bytes of each 128-bit lane.
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+    int numDecoded = 0;
+    for (; numDecoded + 8 <= count && start + 32 <= end; numDecoded += 8, start += 32) {
+        __m256i chars = _mm256_loadu_si256((__m256i*) start);
+        __m256i digits = _mm256_sub_epi8(chars, zeros);
+        unsigned int isDigit = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpgt_epi8(digits, negatives), _mm256_cmpgt_epi8(bound, digits)));
+        unsigned int isSeparator = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(chars, pipes), _mm256_cmpeq_epi8(chars, slashes)));
+        unsigned int isTab = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, tabs));
+        if ((isDigit & 0x55555555) != 0x55555555 || (isSeparator & 0x22222222) != 0x22222222 || (isTab & 0x88888888) != 0x88888888)
+            break;
+        __m256i alleles = _mm256_and_si256(digits, nibbles);
+        __m256i encoded = _mm256_shuffle_epi8(_mm256_or_si256(_mm256_slli_epi32(alleles, 4), _mm256_srli_epi32(alleles, 16)), gather);
+        int low = _mm256_extract_epi32(encoded, 0), high = _mm256_extract_epi32(encoded, 4);
+        memcpy(genotypes + numDecoded, &low, 4);
+        memcpy(genotypes + numDecoded + 4, &high, 4);
+    }
+    return numDecoded;
+}
+#endif
+
+// Picks the widest kernel the CPU supports.
+static int decode_fixed_width_genotypes(char* start, char* end, GENOTYPE* genotypes, int count, int numAlleles) {
+    int numDecoded = 0;
+#ifdef USE_AVX2
+    static int hasAVX2 = -1;
+    if (hasAVX2 < 0)
+        hasAVX2 = __builtin_cpu_supports("avx2");
+    if (hasAVX2)
+        numDecoded = decode_fixed_width_genotypes_avx2(start, end, genotypes, count, numAlleles);
+#endif
+#ifdef USE_SSE2
+    return numDecoded + decode_fixed_width_genotypes_sse2(start + 4 * numDecoded, end, genotypes + numDecoded, count - numDecoded, numAlleles);
+#else
+    return decode_fixed_width_genotypes_scalar(start, end, genotypes, count, numAlleles);
+#endif
+}
+
+// The genotypes of 3 character genotype strings, indexed by the low nibbles of the two alleles.
+//  A digit's low nibble is its value and a '.' has 0xE. The low byte is the genotype with missing
+//  alleles as 0, and the high byte has the nibbles of the missing alleles set.
+#define ALLELE_ENTRY(nibble, shift) ((nibble) == 0xE ? 0x0F00 << (shift) : (nibble) << (shift))
+#define GENOTYPE_ENTRY(key) (ALLELE_ENTRY((key) >> 4, 4) | ALLELE_ENTRY((key) & 0xF, 0))
+#define GENOTYPE_ROW(row) GENOTYPE_ENTRY(row * 16 + 0), GENOTYPE_ENTRY(row * 16 + 1), GENOTYPE_ENTRY(row * 16 + 2), GENOTYPE_ENTRY(row * 16 + 3), \
+                            GENOTYPE_ENTRY(row * 16 + 4), GENOTYPE_ENTRY(row * 16 + 5), GENOTYPE_ENTRY(row * 16 + 6), GENOTYPE_ENTRY(row * 16 + 7), \
+                            GENOTYPE_ENTRY(row * 16 + 8), GENOTYPE_ENTRY(row * 16 + 9), GENOTYPE_ENTRY(row * 16 + 10), GENOTYPE_ENTRY(row * 16 + 11), \
+                            GENOTYPE_ENTRY(row * 16 + 12), GENOTYPE_ENTRY(row * 16 + 13), GENOTYPE_ENTRY(row * 16 + 14), GENOTYPE_ENTRY(row * 16 + 15)
+static const unsigned short genotypeTable[256] = {
+    GENOTYPE_ROW(0), GENOTYPE_ROW(1), GENOTYPE_ROW(2), GENOTYPE_ROW(3), GENOTYPE_ROW(4), GENOTYPE_ROW(5), GENOTYPE_ROW(6), GENOTYPE_ROW(7),
+    GENOTYPE_ROW(8), GENOTYPE_ROW(9), GENOTYPE_ROW(10), GENOTYPE_ROW(11), GENOTYPE_ROW(12), GENOTYPE_ROW(13), GENOTYPE_ROW(14), GENOTYPE_ROW(15)
+};
+
+// The i-th character of a word loaded from a string.
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define WORD_CHAR(word, i) ((char) ((word) >> (8 * (i))))
+#else
+#define WORD_CHAR(word, i) ((char) ((word) >> (8 * (3 - (i)))))
+#endif
+#define IS_ALLELE_CHAR(c) (IS_DIGIT(c) || (c) == '.')
+
+// Decodes a genotype of single digit or missing alleles, such as "0|1", "./.", or "1/0:35",
+//  from its first four characters.
+// Accepts:
+//  char* start -> The start of the genotype.
+//  char* end -> The end of the record. The character at end can be read.
+//  int numAlleles -> The number of alleles at the record.
+//  GENOTYPE* genotype -> Set to the genotype.
+// Returns:
+//  bool, False if the genotype is not in the form or an allele is not below numAlleles.
+//      It is then left to parse_genotype.
+static inline bool lookup_genotype(char* start, char* end, int numAlleles, GENOTYPE* genotype) {
+    if (start + 3 > end)
+        return false;
+    unsigned int word;
+    memcpy(&word, start, 4);
+    if (!IS_ALLELE_CHAR(WORD_CHAR(word, 0)) || !IS_SEPARATOR(WORD_CHAR(word, 1)) || !IS_ALLELE_CHAR(WORD_CHAR(word, 2)) || !IS_GENOTYPE_END(WORD_CHAR(word, 3)))
+        return false;
+    unsigned short entry = genotypeTable[((WORD_CHAR(word, 0) & 0xF) << 4) | (WORD_CHAR(word, 2) & 0xF)];
+    // Missing alleles are 0 in the low byte, so only present alleles are checked.
+    if ((entry & 0xF0) >= (numAlleles << 4) || (entry & 0x0F) >= numAlleles)
+        return false;
+    GENOTYPE missing = (GENOTYPE) ((numAlleles << 4) | numAlleles);
+    *genotype = (GENOTYPE) ((entry & 0xFF) | (missing & (entry >> 8)));
+    return true;
+}
+
+// Decodes consecutive sample columns. Runs of 3 character genotypes are decoded in bulk,
+//  and other genotypes of single digit or missing alleles with a table.
+// Accepts:
+//  char* record -> The start of the first column.
+//  char* end -> The end of the record.
+//  GENOTYPE* genotypes -> The array to fill.
+//  int count -> The number of columns to decode.
+//  int numAlleles -> The number of alleles at the record.
+//  bool* isMalformed -> Set if a genotype is malformed. See parse_genotype.
+// Returns:
+//  char*, The start of the column after the decoded columns.
+static char* decode_genotypes(char* record, char* end, GENOTYPE* genotypes, int count, int numAlleles, bool* isMalformed) {
+    for (int i = 0; i < count && record < end; ) {
+        int numDecoded = decode_fixed_width_genotypes(record, end, genotypes + i, count - i, numAlleles);
+        i += numDecoded;
+        record += 4 * numDecoded;
+        if (i == count || record >= end)
+            break;
+        // Genotypes with missing alleles or other fields break the runs. Only multi-digit alleles are parsed.
+        if (lookup_genotype(record, end, numAlleles, genotypes + i))
+            record += 3;
+        else
+            genotypes[i] = parse_genotype(record, numAlleles, isMalformed);
+        i++;
+        record = (*record == '\t' ? record : find_tab(record, end)) + 1;
+    }
+    return record;
+}
+
+// Memory-maps a file if it is an uncompressed VCF file.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser to set the map of.
+//  char* file_name -> The name of the file to map.
+// Returns:
+//  bool, True if the file was mapped.
+static bool map_vcf_file(VCFGenotypeParser* parser, char* file_name) {
+    int fd = open(file_name, O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileInfo;
+    // GZ files and empty files are not mapped.
+    unsigned char magic[2];
+    if (fstat(fd, &fileInfo) != 0 || !S_ISREG(fileInfo.st_mode) || fileInfo.st_size < 2 || read(fd, magic, 2) != 2 || (magic[0] == 31 && magic[1] == 139)) {
+        close(fd);
+        return false;
+    }
+    char* map = (char*) mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+    // Parsing may read one character past the end of a record, so the file must end with a newline.
+    if (map[fileInfo.st_size - 1] != '\n') {
+        munmap(map, fileInfo.st_size);
+        return false;
+    }
+    madvise(map, fileInfo.st_size, MADV_SEQUENTIAL);
+    parser -> isMapped = true;
+    parser -> map = map;
+    parser -> mapLength = fileInfo.st_size;
+    return true;
+}
+
+// Reads the next line of the VCF file.
+//  For mapped files, the line is not copied.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  char** line -> Set to the start of the line.
+//  char** end -> Set to the end of the line, excluding the newline.
+// Returns:
+//  bool, False if EOF or the line is empty.
+static bool read_next_line(VCFGenotypeParser* parser, char** line, char** end) {
+    if (parser -> isMapped) {
+        if (parser -> offset >= parser -> mapLength)
+            return false;
+        *line = parser -> map + parser -> offset;
+        *end = (char*) memchr(*line, '\n', parser -> mapLength - parser -> offset);
+        parser -> offset = *end - parser -> map + 1;
+        return *end != *line;
+    }
+    if (ks_eof(parser -> stream))
+        return false;
+    int dret;
+    ks_getuntil(parser -> stream, '\n', parser -> buffer, &dret);
+    *line = ks_str(parser -> buffer);
+    *end = *line + ks_len(parser -> buffer);
+    parser -> offset += ks_len(parser -> buffer) + (dret == '\n');
+    return ks_len(parser -> buffer) != 0;
+}
+
+// Creates an empty contig dictionary.
+// Accepts:
+//  void.
+// Returns:
+//  ContigDictionary*, The dictionary.
+static ContigDictionary* init_contig_dictionary() {
+    ContigDictionary* contigs = (ContigDictionary*) calloc(1, sizeof(ContigDictionary));
+    contigs -> maxContigs = 16;
+    contigs -> names = (kstring_t*) calloc(contigs -> maxContigs, sizeof(kstring_t));
+    contigs -> ids = kh_init(contigId);
+    return contigs;
+}
+
+// Finds the id of a chromosome, adding the chromosome if it is new.
+// Accepts:
+//  ContigDictionary* contigs -> The dictionary.
+//  char* name -> The name of the chromosome.
+//  int length -> The length of the name.
+// Returns:
+//  int, The id of the chromosome.
+static int add_contig(ContigDictionary* contigs, char* name, int length) {
+    // The name is not NUL terminated in a record, so copy it into the next free slot first.
+    if (contigs -> numContigs == contigs -> maxContigs) {
+        contigs -> maxContigs *= 2;
+        contigs -> names = (kstring_t*) realloc(contigs -> names, contigs -> maxContigs * sizeof(kstring_t));
+        memset(contigs -> names + contigs -> numContigs, 0, (contigs -> maxContigs - contigs -> numContigs) * sizeof(kstring_t));
+    }
+    kstring_t* slot = &(contigs -> names[contigs -> numContigs]);
+    slot -> l = 0;
+    kputsn(name, length, slot);
+    int ret;
+    khint_t k = kh_put(contigId, contigs -> ids, ks_str(slot), &ret);
+    // A new name keeps the slot. Otherwise, the slot is scratch space for the next lookup.
+    if (ret != 0)
+        kh_val(contigs -> ids, k) = contigs -> numContigs++;
+    return kh_val(contigs -> ids, k);
+}
+
+// Deallocates a contig dictionary.
+// Accepts:
+//  ContigDictionary* contigs -> The dictionary.
+// Returns:
+//  void.
+static void destroy_contig_dictionary(ContigDictionary* contigs) {
+    if (contigs == NULL)
+        return;
+    // Free every slot, including the scratch slot after the last name.
+    for (int i = 0; i < contigs -> maxContigs; i++)
+        free(ks_str(&(contigs -> names[i])));
+    free(contigs -> names);
+    kh_destroy(contigId, contigs -> ids);
+    free(contigs);
+}
+
+// Reads the id of a ##contig header line into the dictionary.
+// Accepts:
+//  ContigDictionary* contigs -> The dictionary.
+//  char* line -> The header line.
+//  char* end -> The end of the line.
+// Returns:
+//  void.
+static void read_contig_line(ContigDictionary* contigs, char* line, char* end) {
+    if (end - line < 11 || strncmp(line, "##contig=<", 10) != 0)
+        return;
+    // Find the ID key among the key-value pairs.
+    for (char* c = line + 10; c + 3 < end; c++) {
+        if ((c[-1] == '<' || c[-1] == ',') && strncmp(c, "ID=", 3) == 0) {
+            char* name = c + 3;
+            char* nameEnd = name;
+            while (nameEnd < end && *nameEnd != ',' && *nameEnd != '>')
+                nameEnd++;
+            if (nameEnd > name)
+                add_contig(contigs, name, nameEnd - name);
+            return;
+        }
+    }
+}
+
+// Sets the chromosome of a record. The name is only copied and looked up when it
+//  differs from the one already in the buffer, which is almost never.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  char* name -> The name in the record.
+//  int length -> The length of the name.
+//  kstring_t* chromosome -> The buffer holding the name.
+//  int* contigId -> The id of the name in the buffer. Set to the id of the new name.
+// Returns:
+//  void.
+static inline void set_chromosome(VCFGenotypeParser* parser, char* name, int length, kstring_t* chromosome, int* contigId) {
+    if (*contigId >= 0 && ks_len(chromosome) == length && memcmp(ks_str(chromosome), name, length) == 0)
+        return;
+    chromosome -> l = 0;
+    kputsn(name, length, chromosome);
+    *contigId = add_contig(parser -> contigs, name, length);
+}
+
+// Selects the samples to parse. Sets num_samples, sample_names, and the runs of the subset.
+//  On failure, all the samples are kept, so the parser can be destroyed.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  kstring_t* sample_names -> The names of every sample column. Unselected names are freed.
+//  int numColumns -> The number of sample columns.
+//  char* samples -> The sample list. See init_vcf_genotype_parser_with_samples.
+// Returns:
+//  bool, False if a sample is not in the file or no samples are left.
+static bool select_samples(VCFGenotypeParser* parser, kstring_t* sample_names, int numColumns, char* samples) {
+
+    parser -> num_samples = numColumns;
+    parser -> sample_names = sample_names;
+    if (samples == NULL)
+        return true;
+
+    bool isExcluded = samples[0] == '^';
+    // Find the column of each name.
+    khash_t(sampleColumn)* columns = kh_init(sampleColumn);
+    kh_resize(sampleColumn, columns, numColumns);
+    int ret;
+    for (int i = 0; i < numColumns; i++) {
+        khint_t k = kh_put(sampleColumn, columns, ks_str(&sample_names[i]), &ret);
+        if (ret != 0)
+            kh_val(columns, k) = i;
+    }
+    bool* isKept = (bool*) calloc(numColumns > 0 ? numColumns : 1, sizeof(bool));
+    for (int i = 0; i < numColumns; i++)
+        isKept[i] = isExcluded;
+    bool isValid = true;
+    kstring_t name = { 0, 0, NULL };
+    for (char* c = samples + isExcluded; *c != '\0' && isValid; ) {
+        char* nameEnd = strchr(c, ',');
+        if (nameEnd == NULL)
+            nameEnd = c + strlen(c);
+        if (nameEnd > c) {
+            name.l = 0;
+            kputsn(c, nameEnd - c, &name);
+            khint_t k = kh_get(sampleColumn, columns, ks_str(&name));
+            if (k == kh_end(columns)) {
+                fprintf(stderr, "Sample %s is not in %s.\n", ks_str(&name), ks_str(parser -> file_name));
+                isValid = false;
+            } else
+                isKept[kh_val(columns, k)] = !isExcluded;
+        }
+        c = *nameEnd == ',' ? nameEnd + 1 : nameEnd;
+    }
+    free(ks_str(&name));
+    kh_destroy(sampleColumn, columns);
+
+    // Group the columns into runs. The names of skipped samples are freed.
+    int num_samples = 0, maxRuns = 4;
+    SampleRun* runs = (SampleRun*) calloc(maxRuns, sizeof(SampleRun));
+    int numRuns = 0;
+    for (int i = 0; i < numColumns && isValid; i++) {
+        if (!isKept[i]) {
+            // Skipped columns start a new run.
+            if (numRuns == 0 || runs[numRuns - 1].numKept > 0) {
+                if (numRuns == maxRuns) {
+                    maxRuns *= 2;
+                    runs = (SampleRun*) realloc(runs, maxRuns * sizeof(SampleRun));
+                }
+                runs[numRuns].numSkipped = 0;
+                runs[numRuns++].numKept = 0;
+            }
+            runs[numRuns - 1].numSkipped++;
+            free(ks_str(&sample_names[i]));
+            memset(&sample_names[i], 0, sizeof(kstring_t));
+            continue;
+        }
+        if (numRuns == 0) {
+            runs[0].numSkipped = 0;
+            runs[numRuns++].numKept = 0;
+        }
+        runs[numRuns - 1].numKept++;
+        // Move the name down to its index in the subset.
+        if (num_samples != i) {
+            sample_names[num_samples] = sample_names[i];
+            memset(&sample_names[i], 0, sizeof(kstring_t));
+        }
+        num_samples++;
+    }
+    free(isKept);
+    if (!isValid || num_samples == 0) {
+        if (isValid)
+            fprintf(stderr, "No samples of %s are left.\n", ks_str(parser -> file_name));
+        free(runs);
+        return false;
+    }
+
+    parser -> num_samples = num_samples;
+    parser -> sampleRuns = runs;
+    // Trailing skipped columns are never read.
+    parser -> numSampleRuns = runs[numRuns - 1].numKept > 0 ? numRuns : numRuns - 1;
+    return true;
+
+}
 
-    // Try to open file.
-    gzFile file = gzopen(file_name, "r");
+// Sets up a parser over a genotype cache.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser with an open cache.
+//  char* file_name -> The name of the cache.
+//  char* samples -> The sample list. See init_vcf_genotype_parser_with_samples.
+// Returns:
+//  VCFGenotypeParser*, The parser primed with the first record, or NULL if the samples are invalid.
+static VCFGenotypeParser* init_cache_parser(VCFGenotypeParser* parser, char* file_name, char* samples) {
 
-    // Make sure the file is in GZ format.
-    int errnum;
-    gzerror(file, &errnum);
-    if (errnum != Z_OK)
+    GenotypeCache* cache = parser -> cache;
+    int num_samples = cache -> header -> numSamples;
+
+    // Copy the sample names.
+    kstring_t* sample_names = (kstring_t*) calloc(num_samples, sizeof(kstring_t));
+    char* name = cache -> sampleNames;
+    for (int i = 0; i < num_samples; i++) {
+        kputs(name, &sample_names[i]);
+        name += ks_len(&sample_names[i]) + 1;
+    }
+
+    parser -> file_name = (kstring_t*) calloc(1, sizeof(kstring_t));
+    kputs(file_name, parser -> file_name);
+    parser -> buffer = (kstring_t*) calloc(1, sizeof(kstring_t));
+    bool isSelected = select_samples(parser, sample_names, num_samples, samples);
+    parser -> isEOF = false;
+    parser -> endOffset = -1;
+    parser -> nextChromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
+    parser -> nextContigId = -1;
+    parser -> nextGenotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    if (!isSelected) {
+        destroy_vcf_genotype_parser(parser);
         return NULL;
-    
-    // Create stream.
-    kstream_t* stream = ks_init(file);
+    }
+
+    // The chromosome runs seed the contig ids.
+    for (unsigned long long i = 0; i < cache -> header -> numChromosomes; i++)
+        add_contig(parser -> contigs, cache -> chromosomeNames + cache -> chromosomes[i].nameOffset, cache -> chromosomes[i].nameLength);
+
+    // Read in first locus to prime the read.
+    get_next_locus(parser, parser -> nextChromosome, &(parser -> nextPosition), &(parser -> nextNumAlleles), &(parser -> nextGenotypes));
+
+    return parser;
+
+}
+
+VCFGenotypeParser* init_vcf_genotype_parser(char* file_name, int numThreads) {
+    return init_vcf_genotype_parser_with_samples(file_name, numThreads, NULL);
+}
+
+VCFGenotypeParser* init_vcf_genotype_parser_with_samples(char* file_name, int numThreads, char* samples) {
+
+    VCFGenotypeParser* parser = (VCFGenotypeParser*) calloc(1, sizeof(VCFGenotypeParser));
+    parser -> contigs = init_contig_dictionary();
+
+    // A cache has no header lines to parse.
+    parser -> cache = open_genotype_cache(file_name);
+    if (parser -> cache != NULL)
+        return init_cache_parser(parser, file_name, samples);
+
+    // Try to map the file. Otherwise, open it with the reader.
+    if (!map_vcf_file(parser, file_name)) {
+        parser -> file = init_bgzf_reader(file_name, numThreads);
+        if (parser -> file == NULL) {
+            destroy_contig_dictionary(parser -> contigs);
+            free(parser);
+            return NULL;
+        }
+        // Create stream.
+        parser -> file -> bufferSize = BUFFER_SIZE;
+        parser -> stream = ks_init(parser -> file);
+    }
     
     // Create buffer to read in VCF file record-by-record.
     kstring_t* buffer = (kstring_t*) calloc(1, sizeof(kstring_t));
-    int dret;
+    parser -> buffer = buffer;
 
     // Swallow header lines.
+    char *line, *end;
     do {
-        ks_getuntil(stream, '\n', buffer, &dret);
-    } while (strncmp(ks_str(buffer), "#C", 2) != 0);
+        // If there is no header line, the file is not a VCF file.
+        if (!read_next_line(parser, &line, &end)) {
+            if (parser -> isMapped)
+                munmap(parser -> map, parser -> mapLength);
+            destroy_bgzf_reader(parser -> file);
+            ks_destroy(parser -> stream);
+            free(ks_str(buffer)); free(buffer);
+            destroy_contig_dictionary(parser -> contigs);
+            free(parser);
+            return NULL;
+        }
+        // The ##contig lines seed the contig ids.
+        read_contig_line(parser -> contigs, line, end);
+    } while (end - line < 2 || strncmp(line, "#C", 2) != 0);
+
+    // Keep a copy of the header line when mapped.
+    if (parser -> isMapped)
+        kputsn(line, end - line, buffer);
     
     // Count the number of samples.
     int num_samples = 0;
@@ -38,29 +716,41 @@ VCFGenotypeParser* init_vcf_genotype_parser(char* file_name) {
             num_samples++;
     num_samples -= 8;
 
+    // Read records through a buffer that holds a whole record, and reserve the line for one.
+    //  Every column is read, even if only a subset of the samples is kept.
+    if (!(parser -> isMapped)) {
+        long recordLength = BYTES_BEFORE_GENOTYPES + (long) BYTES_PER_SAMPLE * (num_samples > 0 ? num_samples : 0);
+        int bufferSize = BUFFER_SIZE;
+        while (bufferSize < recordLength && bufferSize < MAX_BUFFER_SIZE)
+            bufferSize <<= 1;
+        set_stream_buffer_size(parser, bufferSize);
+        ks_resize(buffer, recordLength);
+    }
+
     // Allocate array to hold sample names and fill array.
+    //  Each name runs from the tab before it to the next tab.
     kstring_t* sample_names = (kstring_t*) calloc(num_samples, sizeof(kstring_t));
-    int num_tabs = 0, prev_index;
-    for (int i = 0; i <= ks_len(buffer); i++)
-        if (ks_str(buffer)[i] == '\t') {
-            if (num_tabs > 7)
-                kputsn(ks_str(buffer) + i + 1, i - prev_index, &sample_names[num_tabs - 8]);
-            prev_index = i;
-            num_tabs++;
-        }
+    char* headerEnd = ks_str(buffer) + ks_len(buffer);
+    char* name = skip_fields(ks_str(buffer), headerEnd, 9);
+    for (int i = 0; i < num_samples; i++) {
+        char* nameEnd = find_tab(name, headerEnd);
+        kputsn(name, nameEnd - name, &sample_names[i]);
+        name = nameEnd + 1;
+    }
 
     // Allocate all necessary parser memory and set values.
-    VCFGenotypeParser* parser = (VCFGenotypeParser*) malloc(sizeof(VCFGenotypeParser));
     parser -> file_name = (kstring_t*) calloc(1, sizeof(kstring_t));
     kputs(file_name, parser -> file_name);
-    parser -> file = file;
-    parser -> stream = stream;
-    parser -> num_samples = num_samples;
-    parser -> sample_names = sample_names;
-    parser -> buffer = buffer;
+    bool isSelected = select_samples(parser, sample_names, num_samples, samples);
     parser -> isEOF = false;
+    parser -> endOffset = -1;
     parser -> nextChromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
-    parser -> nextGenotypes = (GENOTYPE*) calloc(num_samples, sizeof(GENOTYPE));
+    parser -> nextContigId = -1;
+    parser -> nextGenotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+    if (!isSelected) {
+        destroy_vcf_genotype_parser(parser);
+        return NULL;
+    }
 
     // Read in first locus to prime the read.
     get_next_locus(parser, parser -> nextChromosome, &(parser -> nextPosition), &(parser -> nextNumAlleles), &(parser -> nextGenotypes));
@@ -70,6 +760,263 @@ VCFGenotypeParser* init_vcf_genotype_parser(char* file_name) {
 
 }
 
+// Compares a record to the current region.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  kstring_t* chromosome -> The chromosome of the record.
+//  int position -> The position of the record.
+// Returns:
+//  int, -1 if the record comes before the region, 0 if it is in the region, and 1 if it is past the region.
+static int compare_to_region(VCFGenotypeParser* parser, kstring_t* chromosome, int position) {
+    Region* region = &(parser -> regions[parser -> currentRegion]);
+    if (ks_len(chromosome) == ks_len(&(region -> chromosome)) && memcmp(ks_str(chromosome), ks_str(&(region -> chromosome)), ks_len(chromosome)) == 0) {
+        parser -> isInRegionChromosome = true;
+        if (position < region -> start)
+            return -1;
+        return position <= region -> end ? 0 : 1;
+    }
+    // Records are sorted within a chromosome, so leaving it ends the region.
+    return parser -> isInRegionChromosome ? 1 : -1;
+}
+
+// Moves the reader to the first record that could be in the current region.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+// Returns:
+//  int, 1 if the reader moved, 0 if the file must be scanned, and -1 if the region has no records.
+static int seek_to_region(VCFGenotypeParser* parser) {
+    Region* region = &(parser -> regions[parser -> currentRegion]);
+    if (parser -> index != NULL) {
+        unsigned long long virtualOffset;
+        if (!query_vcf_index(parser -> index, ks_str(&(region -> chromosome)), region -> start, region -> end, &virtualOffset) || !bgzf_seek(parser -> file, virtualOffset))
+            return -1;
+        ks_rewind(parser -> stream);
+        return 1;
+    }
+    if (parser -> cache != NULL) {
+        GenotypeCache* cache = parser -> cache;
+        for (unsigned long long i = 0; i < cache -> header -> numChromosomes; i++) {
+            CacheChromosome* run = &(cache -> chromosomes[i]);
+            if (run -> nameLength != ks_len(&(region -> chromosome)) || memcmp(cache -> chromosomeNames + run -> nameOffset, ks_str(&(region -> chromosome)), run -> nameLength) != 0)
+                continue;
+            // Binary search the run for the first position in the region.
+            unsigned long long low = run -> firstLocus, high = run -> firstLocus + run -> numLoci;
+            while (low < high) {
+                unsigned long long mid = (low + high) / 2;
+                if (cache -> positions[mid] < region -> start)
+                    low = mid + 1;
+                else
+                    high = mid;
+            }
+            parser -> offset = low;
+            return 1;
+        }
+        return -1;
+    }
+    return 0;
+}
+
+// Moves to the next region that has records.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+// Returns:
+//  int, 1 if the reader moved, 0 if the file must be scanned, and -1 if there are no regions left.
+static int next_region(VCFGenotypeParser* parser) {
+    while (++(parser -> currentRegion) < parser -> numRegions) {
+        parser -> isInRegionChromosome = false;
+        int moved = seek_to_region(parser);
+        if (moved >= 0)
+            return moved;
+    }
+    return -1;
+}
+
+// At the end of the input, moves to the next region that can be sought to.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+// Returns:
+//  bool, True if the reader moved.
+static bool seek_past_end(VCFGenotypeParser* parser) {
+    return parser -> regions != NULL && next_region(parser) > 0;
+}
+
+// The outcomes of locate_record.
+#define RECORD_IN_REGION 0
+#define RECORD_SKIPPED -1
+#define NO_REGIONS_LEFT 1
+
+// Decides if a record is returned. Moves to the next region when the record is past the current one.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  kstring_t* chromosome -> The chromosome of the record.
+//  int position -> The position of the record.
+// Returns:
+//  int, RECORD_IN_REGION, RECORD_SKIPPED, or NO_REGIONS_LEFT.
+static int locate_record(VCFGenotypeParser* parser, kstring_t* chromosome, int position) {
+    if (parser -> regions == NULL)
+        return RECORD_IN_REGION;
+    while (true) {
+        int comparison = compare_to_region(parser, chromosome, position);
+        if (comparison <= 0)
+            return comparison < 0 ? RECORD_SKIPPED : RECORD_IN_REGION;
+        int moved = next_region(parser);
+        if (moved < 0)
+            return NO_REGIONS_LEFT;
+        // After a seek, the record is read again if it is in the region.
+        if (moved > 0)
+            return RECORD_SKIPPED;
+    }
+}
+
+// Copies the next record from a genotype cache. See parse_next_record.
+static bool read_cached_record(VCFGenotypeParser* parser, long* offset, kstring_t* chromosome, int* contigId, int* position, int* numOfAlleles, GENOTYPE* genotypes, PackedGenotypes* packed) {
+
+    GenotypeCache* cache = parser -> cache;
+    unsigned long long locus;
+    int location;
+    do {
+        *offset = parser -> offset;
+        if ((parser -> endOffset >= 0 && parser -> offset >= parser -> endOffset) || parser -> offset >= cache -> header -> numLoci) {
+            if (!seek_past_end(parser))
+                return false;
+            location = RECORD_SKIPPED;
+            continue;
+        }
+        locus = parser -> offset++;
+        CacheChromosome* run = find_cache_chromosome(cache, locus);
+        set_chromosome(parser, cache -> chromosomeNames + run -> nameOffset, run -> nameLength, chromosome, contigId);
+        *position = cache -> positions[locus];
+        if ((location = locate_record(parser, chromosome, *position)) == NO_REGIONS_LEFT)
+            return false;
+    } while (location == RECORD_SKIPPED);
+
+    INSTRUMENT_START(timer);
+    *numOfAlleles = cache -> numAlleles[locus];
+    // Rows hold every sample in the cache. Copy the subset's runs.
+    char* row = cache -> genotypes + locus * cache -> header -> numSamples;
+    if (parser -> sampleRuns == NULL)
+        memcpy(genotypes, row, parser -> num_samples);
+    else {
+        GENOTYPE* run = genotypes;
+        for (int i = 0; i < parser -> numSampleRuns; i++) {
+            row += parser -> sampleRuns[i].numSkipped;
+            memcpy(run, row, parser -> sampleRuns[i].numKept);
+            row += parser -> sampleRuns[i].numKept;
+            run += parser -> sampleRuns[i].numKept;
+        }
+    }
+
+    if (packed != NULL)
+        packed -> isPacked = *numOfAlleles == 2 && pack_genotypes(genotypes, parser -> num_samples, packed);
+    INSTRUMENT_STOP(STAGE_GENOTYPES, timer);
+
+    return true;
+
+}
+
+// Reads the next record and parses it into the given fields.
+//  Used for the peek slot and by the pipeline's parser thread.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+//  long* offset -> Set to the offset of the record.
+//  kstring_t* chromosome -> Set to the chromosome of the record.
+//  int* contigId -> The id of the name in chromosome. Set to the id of the record's chromosome.
+//  int* position -> Set to the position of the record.
+//  int* numOfAlleles -> Set to the number of alleles at the record.
+//  GENOTYPE* genotypes -> Filled with the samples' genotypes.
+//  PackedGenotypes* packed -> If not NULL, filled with the bitplanes of a biallelic record.
+// Returns:
+//  bool, False if EOF, an empty line, or the end of the range.
+static bool parse_next_record(VCFGenotypeParser* parser, long* offset, kstring_t* chromosome, int* contigId, int* position, int* numOfAlleles, GENOTYPE* genotypes, PackedGenotypes* packed) {
+
+    // Copy the record from the cache's columns.
+    if (parser -> cache != NULL)
+        return read_cached_record(parser, offset, chromosome, contigId, position, numOfAlleles, genotypes, packed);
+
+    char *record, *end;
+    int numAlleles, location;
+    do {
+        // Read the next record. If EOF, empty line, or the end of the range, exit.
+        *offset = parser -> offset;
+        INSTRUMENT_START(readTimer);
+        bool isRead = !(parser -> endOffset >= 0 && parser -> offset >= parser -> endOffset) && read_next_line(parser, &record, &end);
+        INSTRUMENT_STOP(STAGE_READ, readTimer);
+        if (!isRead) {
+            if (!seek_past_end(parser))
+                return false;
+            location = RECORD_SKIPPED;
+            continue;
+        }
+
+        INSTRUMENT_START(tokenizeTimer);
+        char* fieldEnd = NULL;
+        numAlleles = 2;
+        char* malformedField = NULL;
+        // Iterate through the first nine fields.
+        for (int field = 0; field < 9 && record < end; field++) {
+            // In the fifth field, count the number of alleles while finding its end.
+            if (field == 4) {
+                fieldEnd = count_alleles(record, end, &numAlleles);
+                if (numAlleles > MAX_ALLELES)
+                    malformedField = "ALT";
+            } else
+                fieldEnd = find_tab(record, end);
+            // In the first field, set the value of chromosome.
+            if (field == 0) {
+                set_chromosome(parser, record, fieldEnd - record, chromosome, contigId);
+            // If the second field, set the value of position.
+            } else if (field == 1 && !parse_position(record, fieldEnd, end, position))
+                malformedField = "POS";
+            record = fieldEnd + 1;
+        }
+        INSTRUMENT_STOP(STAGE_TOKENIZE, tokenizeTimer);
+
+        // A record without a position or with too many alleles cannot be encoded.
+        if (malformedField != NULL) {
+            report_malformed_record(parser, *offset, malformedField);
+            location = RECORD_SKIPPED;
+            continue;
+        }
+
+        // Records outside of the regions are skipped before their genotypes are parsed.
+        if ((location = locate_record(parser, chromosome, *position)) == NO_REGIONS_LEFT)
+            return false;
+    } while (location == RECORD_SKIPPED);
+
+    // Parse each sample's genotype. The columns of samples not in the subset are skipped.
+    INSTRUMENT_START(timer);
+    bool isMalformed = false;
+    if (parser -> sampleRuns == NULL)
+        decode_genotypes(record, end, genotypes, parser -> num_samples, numAlleles, &isMalformed);
+    else {
+        GENOTYPE* run = genotypes;
+        for (int i = 0; i < parser -> numSampleRuns && record < end; i++) {
+            record = skip_fields(record, end, parser -> sampleRuns[i].numSkipped);
+            record = decode_genotypes(record, end, run, parser -> sampleRuns[i].numKept, numAlleles, &isMalformed);
+            run += parser -> sampleRuns[i].numKept;
+        }
+    }
+    if (isMalformed)
+        report_malformed_record(parser, *offset, "genotype");
+
+    // Pack biallelic loci.
+    if (packed != NULL)
+        packed -> isPacked = numAlleles == 2 && pack_genotypes(genotypes, parser -> num_samples, packed);
+    INSTRUMENT_STOP(STAGE_GENOTYPES, timer);
+
+    *numOfAlleles = numAlleles;
+    return true;
+
+}
+
+// Moves the next parsed record from the pipeline into the peek slot.
+//  The peek slot's old buffers are handed back to the parser thread.
+// Accepts:
+//  VCFGenotypeParser* parser -> The parser.
+// Returns:
+//  bool, False if there are no more records.
+static bool next_pipelined_record(VCFGenotypeParser* parser);
+
 void get_next_locus(VCFGenotypeParser* parser, kstring_t* chromosome, int* position, int* numOfAlleles, GENOTYPE** genotypes) {
    
     // Exit if invalid parser or EOF.
@@ -79,59 +1026,563 @@ void get_next_locus(VCFGenotypeParser* parser, kstring_t* chromosome, int* posit
     // If the pointers to nextChromosome and chromosome 
     //  are not equal, then copy the string in nextChromosome
     //  to chromosome.
-    if (parser -> nextChromosome != chromosome) {
+    if (chromosome != NULL && parser -> nextChromosome != chromosome) {
         chromosome -> l = 0;
-        parser -> nextChromosome -> l = 0;
-        kputs(ks_str(parser -> nextChromosome), chromosome);
+        kputsn(ks_str(parser -> nextChromosome), ks_len(parser -> nextChromosome), chromosome);
     }
     // Copy all the values from the primed read into the arguments.
+    parser -> contigId = parser -> nextContigId;
     *position = parser -> nextPosition;
     *numOfAlleles = parser -> nextNumAlleles;
     GENOTYPE* temp = *genotypes;
     *genotypes = parser -> nextGenotypes;
     parser -> nextGenotypes = temp;
+    if (parser -> nextPacked != NULL) {
+        PackedGenotypes* tempPacked = parser -> packed;
+        parser -> packed = parser -> nextPacked;
+        parser -> nextPacked = tempPacked;
+        parser -> nextPacked -> isPacked = false;
+    }
     
-    // If EOF, set flag and exit.
-    if (ks_eof(parser -> stream)) {
+    // Prime the next read. If there is no next record, set flag and exit.
+    if (parser -> pipeline != NULL) {
+        if (!next_pipelined_record(parser))
+            parser -> isEOF = true;
+        return;
+    }
+    if (!parse_next_record(parser, &(parser -> nextLocusOffset), parser -> nextChromosome, &(parser -> nextContigId), &(parser -> nextPosition), &(parser -> nextNumAlleles), parser -> nextGenotypes, parser -> nextPacked))
         parser -> isEOF = true;
+
+}
+
+// Creates empty bitplanes.
+// Accepts:
+//  int numSamples -> The number of samples to pack.
+// Returns:
+//  PackedGenotypes*, The planes.
+static PackedGenotypes* init_packed_genotypes(int numSamples) {
+    PackedGenotypes* packed = (PackedGenotypes*) calloc(1, sizeof(PackedGenotypes));
+    packed -> numWords = (numSamples + 63) / 64;
+    packed -> leftAlternate = (unsigned long long*) calloc(packed -> numWords, sizeof(unsigned long long));
+    packed -> leftMissing = (unsigned long long*) calloc(packed -> numWords, sizeof(unsigned long long));
+    packed -> rightAlternate = (unsigned long long*) calloc(packed -> numWords, sizeof(unsigned long long));
+    packed -> rightMissing = (unsigned long long*) calloc(packed -> numWords, sizeof(unsigned long long));
+    return packed;
+}
+
+// Frees bitplanes.
+// Accepts:
+//  PackedGenotypes* packed -> The planes to free.
+// Returns:
+//  void.
+static void destroy_packed_genotypes(PackedGenotypes* packed) {
+    if (packed == NULL)
         return;
+    free(packed -> leftAlternate);
+    free(packed -> leftMissing);
+    free(packed -> rightAlternate);
+    free(packed -> rightMissing);
+    free(packed);
+}
+
+bool pack_genotypes(GENOTYPE* genotypes, int numSamples, PackedGenotypes* packed) {
+    for (int word = 0; word < packed -> numWords; word++) {
+        unsigned long long leftAlternate = 0, leftMissing = 0, rightAlternate = 0, rightMissing = 0, isValid = 0;
+        int i = 64 * word, bit = 0;
+#ifdef USE_SSE2
+        // Classify 16 genotypes at a time. Each comparison's mask is 16 bits of a plane.
+        const __m128i low = _mm_set1_epi8(0x0F);
+        const __m128i ones = _mm_set1_epi8(1), twos = _mm_set1_epi8(2), zeros = _mm_setzero_si128();
+        for (; bit < 64 && i + 16 <= numSamples; bit += 16, i += 16) {
+            __m128i chunk = _mm_loadu_si128((__m128i*) (genotypes + i));
+            __m128i left = _mm_and_si128(_mm_srli_epi16(chunk, 4), low), right = _mm_and_si128(chunk, low);
+            __m128i isLeftAlternate = _mm_cmpeq_epi8(left, ones), isLeftMissing = _mm_cmpeq_epi8(left, twos);
+            __m128i isRightAlternate = _mm_cmpeq_epi8(right, ones), isRightMissing = _mm_cmpeq_epi8(right, twos);
+            __m128i isValidChunk = _mm_and_si128(_mm_or_si128(_mm_or_si128(isLeftAlternate, isLeftMissing), _mm_cmpeq_epi8(left, zeros)),
+                                                 _mm_or_si128(_mm_or_si128(isRightAlternate, isRightMissing), _mm_cmpeq_epi8(right, zeros)));
+            leftAlternate |= (unsigned long long) _mm_movemask_epi8(isLeftAlternate) << bit;
+            leftMissing |= (unsigned long long) _mm_movemask_epi8(isLeftMissing) << bit;
+            rightAlternate |= (unsigned long long) _mm_movemask_epi8(isRightAlternate) << bit;
+            rightMissing |= (unsigned long long) _mm_movemask_epi8(isRightMissing) << bit;
+            isValid |= (unsigned long long) _mm_movemask_epi8(isValidChunk) << bit;
+        }
+#endif
+        for (; bit < 64 && i < numSamples; bit++, i++) {
+            unsigned char left = (unsigned char) genotypes[i] >> 4, right = genotypes[i] & 0x0F;
+            leftAlternate |= (unsigned long long) (left == 1) << bit;
+            leftMissing |= (unsigned long long) (left == 2) << bit;
+            rightAlternate |= (unsigned long long) (right == 1) << bit;
+            rightMissing |= (unsigned long long) (right == 2) << bit;
+            isValid |= (unsigned long long) (left <= 2 && right <= 2) << bit;
+        }
+        // Every sample in the word must be packable.
+        if (isValid != (bit == 64 ? ~0ULL : (1ULL << bit) - 1))
+            return false;
+        packed -> leftAlternate[word] = leftAlternate;
+        packed -> leftMissing[word] = leftMissing;
+        packed -> rightAlternate[word] = rightAlternate;
+        packed -> rightMissing[word] = rightMissing;
     }
+    return true;
+}
 
-    // Read the next record into the buffer.
-    int dret;
-    ks_getuntil(parser -> stream, '\n', parser -> buffer, &dret);
+void enable_genotype_packing(VCFGenotypeParser* parser) {
+    if (parser == NULL || parser -> nextPacked != NULL)
+        return;
+    parser -> packed = init_packed_genotypes(parser -> num_samples);
+    parser -> nextPacked = init_packed_genotypes(parser -> num_samples);
+    // Pack the primed record.
+    if (!(parser -> isEOF) && parser -> nextNumAlleles == 2)
+        parser -> nextPacked -> isPacked = pack_genotypes(parser -> nextGenotypes, parser -> num_samples, parser -> nextPacked);
+}
+
+// Waits on the other side of the pipeline to move head or tail. Spins, then sleeps
+//  until the other side signals.
+// Accepts:
+//  LocusPipeline* pipeline -> The pipeline.
+//  unsigned long* counter -> The head or the tail.
+//  unsigned long value -> Returns once the counter is no longer this value.
+// Returns:
+//  void.
+static void wait_on_pipeline(LocusPipeline* pipeline, unsigned long* counter, unsigned long value) {
+    for (int spins = 0; spins < PIPELINE_SPINS; spins++) {
+        if (__atomic_load_n(counter, __ATOMIC_ACQUIRE) != value || __atomic_load_n(&(pipeline -> isShutdown), __ATOMIC_ACQUIRE))
+            return;
+#ifdef USE_SSE2
+        _mm_pause();
+#endif
+    }
+    pthread_mutex_lock(&(pipeline -> lock));
+    __atomic_fetch_add(&(pipeline -> numSleeping), 1, __ATOMIC_SEQ_CST);
+    while (__atomic_load_n(counter, __ATOMIC_SEQ_CST) == value && !(pipeline -> isShutdown))
+        pthread_cond_wait(&(pipeline -> moved), &(pipeline -> lock));
+    __atomic_fetch_sub(&(pipeline -> numSleeping), 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&(pipeline -> lock));
+}
+
+// Moves head or tail and wakes the other side if it is asleep.
+// Accepts:
+//  LocusPipeline* pipeline -> The pipeline.
+//  unsigned long* counter -> The head or the tail.
+//  unsigned long value -> The new value of the counter.
+// Returns:
+//  void.
+static void move_pipeline(LocusPipeline* pipeline, unsigned long* counter, unsigned long value) {
+    __atomic_store_n(counter, value, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&(pipeline -> numSleeping), __ATOMIC_SEQ_CST) > 0) {
+        pthread_mutex_lock(&(pipeline -> lock));
+        pthread_cond_broadcast(&(pipeline -> moved));
+        pthread_mutex_unlock(&(pipeline -> lock));
+    }
+}
+
+// The parser thread. Fills batches until EOF or shutdown.
+// Accepts:
+//  void* arg -> The parser.
+// Returns:
+//  void*, NULL.
+static void* parse_records(void* arg) {
+
+    VCFGenotypeParser* parser = (VCFGenotypeParser*) arg;
+    LocusPipeline* pipeline = parser -> pipeline;
+
+    bool isEOF = false;
+    while (!isEOF) {
+        // Wait for the consumer to release a batch. Only this thread writes tail.
+        unsigned long tail = pipeline -> tail;
+        while (tail - __atomic_load_n(&(pipeline -> head), __ATOMIC_ACQUIRE) == PIPELINE_NUM_BATCHES) {
+            if (__atomic_load_n(&(pipeline -> isShutdown), __ATOMIC_ACQUIRE))
+                return NULL;
+            wait_on_pipeline(pipeline, &(pipeline -> head), tail - PIPELINE_NUM_BATCHES);
+        }
+        // Fill the batch and publish it.
+        LocusBatch* batch = &(pipeline -> batches[tail % PIPELINE_NUM_BATCHES]);
+        batch -> numLoci = 0;
+        while (batch -> numLoci < pipeline -> batchSize) {
+            ParsedLocus* locus = &(batch -> loci[batch -> numLoci]);
+            if (!parse_next_record(parser, &(locus -> offset), &(locus -> chromosome), &(locus -> contigId), &(locus -> position), &(locus -> numAlleles), locus -> genotypes, locus -> packed)) {
+                isEOF = true;
+                break;
+            }
+            batch -> numLoci++;
+        }
+        batch -> isEOF = isEOF;
+        move_pipeline(pipeline, &(pipeline -> tail), tail + 1);
+    }
+
+    return NULL;
+
+}
+
+static bool next_pipelined_record(VCFGenotypeParser* parser) {
+
+    LocusPipeline* pipeline = parser -> pipeline;
+
+    // Only this thread writes head.
+    unsigned long head = pipeline -> head;
+    while (__atomic_load_n(&(pipeline -> tail), __ATOMIC_ACQUIRE) == head)
+        wait_on_pipeline(pipeline, &(pipeline -> tail), head);
+
+    LocusBatch* batch = &(pipeline -> batches[head % PIPELINE_NUM_BATCHES]);
+    if (pipeline -> nextLocus == batch -> numLoci)
+        return false;
+
+    // Swap the record into the peek slot.
+    ParsedLocus* locus = &(batch -> loci[pipeline -> nextLocus++]);
+    kstring_t tempChromosome = *(parser -> nextChromosome);
+    *(parser -> nextChromosome) = locus -> chromosome;
+    locus -> chromosome = tempChromosome;
+    int tempContigId = parser -> nextContigId;
+    parser -> nextContigId = locus -> contigId;
+    locus -> contigId = tempContigId;
+    GENOTYPE* tempGenotypes = parser -> nextGenotypes;
+    parser -> nextGenotypes = locus -> genotypes;
+    locus -> genotypes = tempGenotypes;
+    if (locus -> packed != NULL) {
+        PackedGenotypes* tempPacked = parser -> nextPacked;
+        parser -> nextPacked = locus -> packed;
+        locus -> packed = tempPacked;
+    }
+    parser -> nextPosition = locus -> position;
+    parser -> nextNumAlleles = locus -> numAlleles;
+    parser -> nextLocusOffset = locus -> offset;
+
+    // Release the batch as soon as it is drained. The last batch is kept to report EOF.
+    if (pipeline -> nextLocus == batch -> numLoci && !(batch -> isEOF)) {
+        pipeline -> nextLocus = 0;
+        move_pipeline(pipeline, &(pipeline -> head), head + 1);
+    }
+
+    return true;
+
+}
+
+void set_stream_buffer_size(VCFGenotypeParser* parser, int bufferSize) {
+    if (parser -> stream == NULL || bufferSize <= 0)
+        return;
+    kstream_t* stream = parser -> stream;
+    // Move the unread bytes to the front, so a smaller buffer still holds them.
+    if (stream -> begin > 0 && stream -> begin < stream -> end) {
+        memmove(stream -> buf, stream -> buf + stream -> begin, stream -> end - stream -> begin);
+        stream -> end -= stream -> begin;
+        stream -> begin = 0;
+    }
+    if (bufferSize < stream -> end)
+        bufferSize = stream -> end;
+    stream -> buf = (unsigned char*) realloc(stream -> buf, bufferSize);
+    parser -> file -> bufferSize = bufferSize;
+}
+
+void enable_locus_pipelining(VCFGenotypeParser* parser) {
+
+    if (parser == NULL || parser -> pipeline != NULL || parser -> isEOF)
+        return;
+
+    // With a single core, the threads would only take turns.
+    if (sysconf(_SC_NPROCESSORS_ONLN) < 2)
+        return;
+
+    LocusPipeline* pipeline = (LocusPipeline*) calloc(1, sizeof(LocusPipeline));
+
+    // Large samples get smaller batches, so the pool stays bounded.
+    pipeline -> batchSize = parser -> num_samples > 0 ? PIPELINE_BATCH_BYTES / parser -> num_samples : PIPELINE_MAX_BATCH_SIZE;
+    if (pipeline -> batchSize < 1)
+        pipeline -> batchSize = 1;
+    if (pipeline -> batchSize > PIPELINE_MAX_BATCH_SIZE)
+        pipeline -> batchSize = PIPELINE_MAX_BATCH_SIZE;
 
-    // If empty line, set EOF and exit.
-    if (ks_len(parser -> buffer) == 0) {
+    // Allocate the pool of buffers.
+    pipeline -> batches = (LocusBatch*) calloc(PIPELINE_NUM_BATCHES, sizeof(LocusBatch));
+    for (int i = 0; i < PIPELINE_NUM_BATCHES; i++) {
+        pipeline -> batches[i].loci = (ParsedLocus*) calloc(pipeline -> batchSize, sizeof(ParsedLocus));
+        for (int j = 0; j < pipeline -> batchSize; j++) {
+            pipeline -> batches[i].loci[j].contigId = -1;
+            pipeline -> batches[i].loci[j].genotypes = (GENOTYPE*) calloc(parser -> num_samples, sizeof(GENOTYPE));
+            if (parser -> nextPacked != NULL)
+                pipeline -> batches[i].loci[j].packed = init_packed_genotypes(parser -> num_samples);
+        }
+    }
+
+    pthread_mutex_init(&(pipeline -> lock), NULL);
+    pthread_cond_init(&(pipeline -> moved), NULL);
+
+    // The thread owns the stream from here on.
+    parser -> pipeline = pipeline;
+    pthread_create(&(pipeline -> thread), NULL, parse_records, parser);
+
+}
+
+// Stops the parser thread and frees the pool.
+// Accepts:
+//  LocusPipeline* pipeline -> The pipeline to destroy.
+// Returns:
+//  void.
+static void destroy_locus_pipeline(LocusPipeline* pipeline) {
+    if (pipeline == NULL)
+        return;
+    pthread_mutex_lock(&(pipeline -> lock));
+    __atomic_store_n(&(pipeline -> isShutdown), true, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&(pipeline -> moved));
+    pthread_mutex_unlock(&(pipeline -> lock));
+    pthread_join(pipeline -> thread, NULL);
+    pthread_mutex_destroy(&(pipeline -> lock));
+    pthread_cond_destroy(&(pipeline -> moved));
+    for (int i = 0; i < PIPELINE_NUM_BATCHES; i++) {
+        for (int j = 0; j < pipeline -> batchSize; j++) {
+            free(pipeline -> batches[i].loci[j].chromosome.s);
+            free(pipeline -> batches[i].loci[j].genotypes);
+            destroy_packed_genotypes(pipeline -> batches[i].loci[j].packed);
+        }
+        free(pipeline -> batches[i].loci);
+    }
+    free(pipeline -> batches);
+    free(pipeline);
+}
+
+// Parses a list of regions.
+// Accepts:
+//  char* list -> Regions separated by commas or whitespace.
+//  int* numRegions -> Set to the number of regions.
+// Returns:
+//  Region*, The regions, or NULL if one is malformed or there are none.
+static Region* parse_regions(char* list, int* numRegions) {
+    int maxRegions = 4;
+    Region* regions = (Region*) calloc(maxRegions, sizeof(Region));
+    *numRegions = 0;
+    bool isValid = true;
+    for (char* c = list; *c != '\0' && isValid; ) {
+        // Find the next region.
+        while (*c == ',' || isspace(*c))
+            c++;
+        char* tokenEnd = c;
+        while (*tokenEnd != '\0' && *tokenEnd != ',' && !isspace(*tokenEnd))
+            tokenEnd++;
+        if (tokenEnd == c)
+            break;
+        if (*numRegions == maxRegions) {
+            maxRegions *= 2;
+            regions = (Region*) realloc(regions, maxRegions * sizeof(Region));
+        }
+        Region* region = &(regions[(*numRegions)++]);
+        memset(region, 0, sizeof(Region));
+        region -> start = 1;
+        region -> end = INT_MAX;
+        // Chromosome names may contain a colon, so only the last one can start the interval.
+        char* colon = NULL;
+        for (char* d = c; d < tokenEnd; d++)
+            if (*d == ':')
+                colon = d;
+        char* nameEnd = tokenEnd;
+        if (colon != NULL && colon + 1 < tokenEnd && IS_DIGIT(colon[1])) {
+            char* next;
+            region -> start = (int) strtol(colon + 1, &next, 10);
+            if (next < tokenEnd && *next == '-' && next + 1 < tokenEnd)
+                region -> end = (int) strtol(next + 1, &next, 10);
+            else if (next < tokenEnd && *next == '-')
+                next++;
+            isValid = next == tokenEnd && region -> start >= 1 && region -> start <= region -> end;
+            nameEnd = colon;
+        }
+        kputsn(c, nameEnd - c, &(region -> chromosome));
+        isValid = isValid && nameEnd > c;
+        c = tokenEnd;
+    }
+    if (!isValid || *numRegions == 0) {
+        for (int i = 0; i < *numRegions; i++)
+            free(ks_str(&(regions[i].chromosome)));
+        free(regions);
+        return NULL;
+    }
+    return regions;
+}
+
+bool set_vcf_regions(VCFGenotypeParser* parser, char* list) {
+
+    if (parser == NULL || parser -> pipeline != NULL)
+        return false;
+
+    int numRegions;
+    Region* regions = parse_regions(list, &numRegions);
+    if (regions == NULL)
+        return false;
+
+    // Replace any previous regions.
+    for (int i = 0; i < parser -> numRegions; i++)
+        free(ks_str(&(parser -> regions[i].chromosome)));
+    free(parser -> regions);
+    parser -> regions = regions;
+    parser -> numRegions = numRegions;
+    parser -> currentRegion = -1;
+    parser -> endOffset = -1;
+
+    // Load the index of a BGZF file once.
+    if (parser -> index == NULL && parser -> file != NULL && parser -> file -> isBGZF)
+        parser -> index = load_vcf_index(ks_str(parser -> file_name));
+
+    // Move to the first region with records.
+    int moved = next_region(parser);
+    if (moved < 0) {
         parser -> isEOF = true;
+        return true;
+    }
+
+    // When scanning, the primed record is the first candidate.
+    if (moved == 0 && !(parser -> isEOF)) {
+        int location = locate_record(parser, parser -> nextChromosome, parser -> nextPosition);
+        if (location == RECORD_IN_REGION)
+            return true;
+        if (location == NO_REGIONS_LEFT) {
+            parser -> isEOF = true;
+            return true;
+        }
+    }
+
+    // Prime the read with the first record in the regions.
+    parser -> isEOF = false;
+    get_next_locus(parser, parser -> nextChromosome, &(parser -> nextPosition), &(parser -> nextNumAlleles), &(parser -> nextGenotypes));
+    return true;
+
+}
+
+void seek_vcf_genotype_parser(VCFGenotypeParser* parser, long startOffset, long endOffset) {
+
+    if (parser == NULL)
+        return;
+
+    parser -> endOffset = endOffset;
+
+    // If the record is already primed, check that it lies in the range.
+    if (parser -> nextLocusOffset == startOffset) {
+        if (endOffset >= 0 && startOffset >= endOffset)
+            parser -> isEOF = true;
         return;
     }
 
-    // Prime the next read by parsing the record.
-    //  Iterate through the buffer string.
-    int num_tabs = 0, prev_index = 0, numAlleles = 2;
-    for (int i = 0; i <= ks_len(parser -> buffer); i++) {
-        if (i == ks_len(parser -> buffer) || ks_str(parser -> buffer)[i] == '\t') {
-            // In the first field, set the value of nextChromosome.
-            if (num_tabs == 0)
-                kputsn(ks_str(parser -> buffer), i - prev_index, parser -> nextChromosome);
-            // If the second field, set the value of nextPosition.
-            else if (num_tabs == 1)
-                parser -> nextPosition = (int) strtol(ks_str(parser -> buffer) + prev_index + 1, (char**) NULL, 10);
-            // If the fifth field, count the number of alleles.
-            else if (num_tabs == 4) {
-                for (int j = prev_index + 1; ks_str(parser -> buffer)[j] != '\t'; j++)
-                    if (ks_str(parser -> buffer)[j] == ',')
-                        numAlleles++;
-            // If the 9th field or greater, parse each sample's genotype.
-            } else if (num_tabs > 8)
-                parser -> nextGenotypes[num_tabs - 9] = parse_genotype(ks_str(parser -> buffer) + prev_index + 1, numAlleles);
-            prev_index = i;
-            num_tabs++;
+    // Skip lines without parsing them.
+    char *line, *end;
+    if (parser -> isMapped || parser -> cache != NULL)
+        parser -> offset = startOffset;
+    while (parser -> offset < startOffset)
+        if (!read_next_line(parser, &line, &end))
+            break;
+
+    // Prime the read with the first record in the range.
+    parser -> isEOF = false;
+    get_next_locus(parser, parser -> nextChromosome, &(parser -> nextPosition), &(parser -> nextNumAlleles), &(parser -> nextGenotypes));
+
+}
+
+void enable_checkpointing(VCFGenotypeParser* parser) {
+    if (parser == NULL || parser -> stream == NULL || parser -> pipeline != NULL || !(parser -> file -> isBGZF))
+        return;
+    // The stream holds bytes of blocks released before logging started. Read the lines up
+    //  to the parser's position again, so every block the parser reads from is logged.
+    long offset = parser -> offset;
+    if (!bgzf_seek(parser -> file, 0))
+        return;
+    ks_rewind(parser -> stream);
+    parser -> offset = 0;
+    bgzf_log_blocks(parser -> file, 0);
+    char *line, *end;
+    while (parser -> offset < offset)
+        if (!read_next_line(parser, &line, &end))
+            break;
+}
+
+bool tell_vcf_genotype_parser(VCFGenotypeParser* parser, long* offset, unsigned long long* virtualOffset) {
+
+    // Offsets are not kept when regions are sought to.
+    if (parser == NULL || parser -> isEOF || parser -> regions != NULL)
+        return false;
+
+    *offset = parser -> nextLocusOffset;
+    *virtualOffset = 0;
+    if (parser -> file != NULL && parser -> file -> isLoggingBlocks)
+        return bgzf_virtual_offset(parser -> file, *offset, virtualOffset);
+    return true;
+
+}
+
+bool resume_vcf_genotype_parser(VCFGenotypeParser* parser, long offset, unsigned long long virtualOffset) {
+
+    if (parser == NULL || parser -> pipeline != NULL || parser -> regions != NULL || parser -> isEOF)
+        return false;
+
+    // Without a virtual offset, the lines before the record are skipped.
+    if (virtualOffset == 0 || parser -> file == NULL || !(parser -> file -> isBGZF)) {
+        if (offset < parser -> nextLocusOffset)
+            return false;
+        seek_vcf_genotype_parser(parser, offset, -1);
+        return true;
+    }
+
+    bool isLoggingBlocks = parser -> file -> isLoggingBlocks;
+    if (!bgzf_seek(parser -> file, virtualOffset))
+        return false;
+    ks_rewind(parser -> stream);
+    parser -> offset = offset;
+    if (isLoggingBlocks)
+        bgzf_log_blocks(parser -> file, offset);
+
+    // Prime the read with the record at the offset.
+    parser -> isEOF = false;
+    get_next_locus(parser, parser -> nextChromosome, &(parser -> nextPosition), &(parser -> nextNumAlleles), &(parser -> nextGenotypes));
+    return true;
+
+}
+
+ChromosomeRange* scan_chromosome_ranges(char* file_name, int numThreads, int* numChromosomes) {
+
+    VCFGenotypeParser* parser = init_vcf_genotype_parser(file_name, numThreads);
+    if (parser == NULL)
+        return NULL;
+
+    int numRanges = 0, maxRanges = 16;
+    ChromosomeRange* ranges = (ChromosomeRange*) calloc(maxRanges, sizeof(ChromosomeRange));
+
+    // A cache's runs are the ranges.
+    GenotypeCache* cache = parser -> cache;
+    if (cache != NULL) {
+        numRanges = cache -> header -> numChromosomes;
+        ranges = (ChromosomeRange*) realloc(ranges, (numRanges > 0 ? numRanges : 1) * sizeof(ChromosomeRange));
+        for (int i = 0; i < numRanges; i++) {
+            ranges[i].chromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
+            kputsn(cache -> chromosomeNames + cache -> chromosomes[i].nameOffset, cache -> chromosomes[i].nameLength, ranges[i].chromosome);
+            ranges[i].startOffset = cache -> chromosomes[i].firstLocus;
+            ranges[i].endOffset = i + 1 < numRanges ? (long) cache -> chromosomes[i + 1].firstLocus : -1;
         }
+        destroy_vcf_genotype_parser(parser);
+        *numChromosomes = numRanges;
+        return ranges;
     }
 
-    parser -> nextNumAlleles = numAlleles;
+    // The primed record starts the first range.
+    long lineOffset = parser -> nextLocusOffset;
+    char *line = ks_str(parser -> nextChromosome), *end = line + ks_len(parser -> nextChromosome);
+    bool isRecord = !(parser -> isEOF);
+    while (isRecord) {
+        char* chromosomeEnd = find_tab(line, end);
+        // Start a new range when the chromosome changes.
+        if (numRanges == 0 || ks_len(ranges[numRanges - 1].chromosome) != chromosomeEnd - line || strncmp(ks_str(ranges[numRanges - 1].chromosome), line, chromosomeEnd - line) != 0) {
+            if (numRanges == maxRanges) {
+                maxRanges *= 2;
+                ranges = (ChromosomeRange*) realloc(ranges, maxRanges * sizeof(ChromosomeRange));
+            }
+            if (numRanges > 0)
+                ranges[numRanges - 1].endOffset = lineOffset;
+            ranges[numRanges].chromosome = (kstring_t*) calloc(1, sizeof(kstring_t));
+            kputsn(line, chromosomeEnd - line, ranges[numRanges].chromosome);
+            ranges[numRanges].startOffset = lineOffset;
+            ranges[numRanges].endOffset = -1;
+            numRanges++;
+        }
+        lineOffset = parser -> offset;
+        isRecord = read_next_line(parser, &line, &end);
+    }
+
+    destroy_vcf_genotype_parser(parser);
+    *numChromosomes = numRanges;
+    return ranges;
 
 }
 
@@ -139,20 +1590,34 @@ void destroy_vcf_genotype_parser(VCFGenotypeParser* parser) {
     if (parser == NULL)
         return;
 
+    // Stop the parser thread before the file is closed.
+    destroy_locus_pipeline(parser -> pipeline);
     // Free everything sued to read in the file.
-    gzclose(parser -> file);
+    if (parser -> isMapped)
+        munmap(parser -> map, parser -> mapLength);
+    close_genotype_cache(parser -> cache);
+    destroy_vcf_index(parser -> index);
+    for (int i = 0; i < parser -> numRegions; i++)
+        free(ks_str(&(parser -> regions[i].chromosome)));
+    free(parser -> regions);
+    destroy_bgzf_reader(parser -> file);
     ks_destroy(parser -> stream);
     free(ks_str(parser -> file_name)); free(parser -> file_name);
     // Free all sample names array.
     for (int i = 0; i < parser -> num_samples; i++)
         free(parser -> sample_names[i].s);
     free(parser -> sample_names);
+    free(parser -> sampleRuns);
     // Free the buffer.
     free(ks_str(parser -> buffer)); free(parser -> buffer);
     // Free the nextChromosome string.
     free(ks_str(parser -> nextChromosome)); free(parser -> nextChromosome);
+    destroy_contig_dictionary(parser -> contigs);
     // Free the genotypes array array.
     free(parser -> nextGenotypes);
+    // Free the bitplanes.
+    destroy_packed_genotypes(parser -> packed);
+    destroy_packed_genotypes(parser -> nextPacked);
     // Free the structure.
     free(parser);
 }
@@ -161,7 +1626,7 @@ void destroy_vcf_genotype_parser(VCFGenotypeParser* parser) {
 /*
 int main() {
     
-    VCFGenotypeParser* parser = init_vcf_genotype_parser("vcf_parser_test.vcf.gz");
+    VCFGenotypeParser* parser = init_vcf_genotype_parser("vcf_parser_test.vcf.gz", 0);
 
     printf("There are %d samples with the following names:\n", parser -> num_samples);
     for (int i = 0; i < parser -> num_samples; i++)
@@ -11,29 +11,150 @@
 
 #include <stdbool.h>
 
-// Supports GZIP VCF files.
-#include "../klib/zlib.h"
+// Supports GZIP VCF files. BGZF blocks are inflated in parallel.
+#include "BGZFReader.h"
+
+// Repeated scans can read a binary cache of the genotypes instead.
+#include "GenotypeCache.h"
+
+// Regions of BGZF files are found with a tabix or CSI index.
+#include "VCFIndex.h"
 
 #include "../klib/kstring.h"
 
 // We use the klib wrapper to read in streams.
 #include "../klib/kseq.h"
 
-// Initiate the klib stream.
-#define BUFFER_SIZE 4096
-KSTREAM_INIT(gzFile, gzread, BUFFER_SIZE)
+// Chromosome names are mapped to ids with a klib hash table.
+#include "../klib/khash.h"
+
+// The size of the stream's buffer while the header is read. Afterwards, the buffer is
+//  sized to hold a record. See set_stream_buffer_size.
+#define BUFFER_SIZE 65536
+// The largest buffer sized from the number of samples.
+#define MAX_BUFFER_SIZE (1 << 24)
+// The bytes of a record per sample, assuming only GT. Longer records take more reads.
+#define BYTES_PER_SAMPLE 4
+// The bytes of a record before the genotypes.
+#define BYTES_BEFORE_GENOTYPES 256
+
+// Initiate the klib stream. The buffer size is read from the reader at run time.
+//  kseq names the stream ks in each of its functions.
+KSTREAM_INIT(BGZFReader*, bgzf_read, ks -> f -> bufferSize)
+
+// Maps a chromosome name to its id.
+KHASH_MAP_INIT_STR(contigId, int)
+
+// Maps each chromosome to an integer id, so records compare ids instead of names.
+//  Ids are given in the order of the ##contig header lines, then in the order
+//  chromosomes are first seen.
+typedef struct {
+    int numContigs;
+    int maxContigs;
+    // The names, indexed by id.
+    kstring_t* names;
+    // The keys point into names.
+    khash_t(contigId)* ids;
+} ContigDictionary;
 
 // A sample's genotype is encoded in a byte.
 //  Therefore, there is a maximum of 15 possible
 //  alleles and the missing allele at each locus.
 typedef char GENOTYPE;
+#define MAX_ALLELES 15
+
+// Biallelic genotypes packed into bitplanes of 64 samples per word.
+//  Bit i of a word is set if sample i has the allele, or has a missing allele.
+typedef struct {
+    // The number of 64-bit words in each plane.
+    int numWords;
+    // Set if the locus was biallelic and could be packed. Otherwise, the planes are stale.
+    bool isPacked;
+    // The left haplotypes that carry the alternate allele.
+    unsigned long long* leftAlternate;
+    // The left haplotypes with a missing allele.
+    unsigned long long* leftMissing;
+    // The right haplotypes that carry the alternate allele.
+    unsigned long long* rightAlternate;
+    // The right haplotypes with a missing allele.
+    unsigned long long* rightMissing;
+} PackedGenotypes;
+
+// The number of batches in the ring between the parser thread and the consumer.
+#define PIPELINE_NUM_BATCHES 8
+
+// The genotype buffers of a batch take about this many bytes. Sets the number of loci in a batch.
+#define PIPELINE_BATCH_BYTES 262144
+
+// The maximum number of loci in a batch.
+#define PIPELINE_MAX_BATCH_SIZE 64
+
+// The number of times a side of the pipeline checks the other before it sleeps.
+#define PIPELINE_SPINS 1024
+
+// A record parsed by the parser thread.
+typedef struct {
+    // The offset of the record in the uncompressed file.
+    long offset;
+    kstring_t chromosome;
+    int contigId;
+    int position;
+    int numAlleles;
+    // Buffers are swapped, not copied, with the peek slot, so they circulate as a pool.
+    GENOTYPE* genotypes;
+    PackedGenotypes* packed;
+} ParsedLocus;
+
+// A batch of records parsed by the parser thread.
+typedef struct {
+    // The number of records in the batch.
+    int numLoci;
+    // Set if there are no records after the batch.
+    bool isEOF;
+    ParsedLocus* loci;
+} LocusBatch;
+
+// A single producer, single consumer ring of batches. The parser thread fills
+//  batches at tail and the consumer drains them at head. Neither takes a lock
+//  unless the other side is asleep.
+typedef struct {
+    LocusBatch* batches;
+    // The number of records in a full batch.
+    int batchSize;
+    // The number of batches published and released. Only ever increase.
+    unsigned long head;
+    unsigned long tail;
+    // The next record in the batch at head.
+    int nextLocus;
+    // Set to stop the parser thread.
+    bool isShutdown;
+    pthread_t thread;
+    // A side that stops spinning sleeps on the condition until head or tail moves.
+    int numSleeping;
+    pthread_mutex_t lock;
+    pthread_cond_t moved;
+} LocusPipeline;
+
+// A run of sample columns in a subset. The parser skips numSkipped columns,
+//  then decodes numKept columns.
+typedef struct {
+    int numSkipped;
+    int numKept;
+} SampleRun;
+
+// A region of a chromosome. Positions are 1-based and inclusive.
+typedef struct {
+    kstring_t chromosome;
+    int start;
+    int end;
+} Region;
 
 // Our parser structure.
 typedef struct {
     // The name of the VCF file.
     kstring_t* file_name;
-    // Our GZ file structure.
-    gzFile file;
+    // Our reader for the GZ file.
+    BGZFReader* file;
     // The stream we will read from the gzFile.
     kstream_t* stream;
     // The dynamic buffer used by kseq.
@@ -41,31 +162,208 @@ typedef struct {
     // Flag set when EOF.
     bool isEOF;
 
+    // Uncompressed VCF files are memory-mapped and tokenized in place.
+    //  If set, file and stream are not used.
+    bool isMapped;
+    // The contents of the file.
+    char* map;
+    // The size of the file.
+    size_t mapLength;
+
+    // If set, the file is a genotype cache and records are copied from its columns.
+    //  Offsets are then the indices of records.
+    GenotypeCache* cache;
+
+    // The offset of the next line in the uncompressed file.
+    long offset;
+    // The offset of the record in the peek slot.
+    long nextLocusOffset;
+    // The parser stops at the record starting at this offset. If -1, it reads to the end of the file.
+    long endOffset;
+    // The number of records with a malformed field. Records with a malformed POS or too many
+    //  alleles are skipped. A malformed allele in a genotype is read as missing.
+    long numMalformedRecords;
+
     // The number of samples in the VCF file.
     int num_samples;
     // The names of the samples.
     kstring_t* sample_names;
 
+    // If set, only a subset of the samples is parsed. num_samples and sample_names
+    //  then describe the subset, and the other columns are skipped as runs.
+    SampleRun* sampleRuns;
+    int numSampleRuns;
+
     // By adding a "peak" mechanism to the VCF file, such as we can do in streams,
     //  many algorithms are simplified. The stream is pointing the record after
     //  these entries.
     kstring_t* nextChromosome;
+    int nextContigId;
     int nextPosition;
     int nextNumAlleles;
     GENOTYPE* nextGenotypes;
+
+    // If packing is enabled, biallelic loci are also packed into bitplanes.
+    //  The planes of the locus last returned by get_next_locus.
+    PackedGenotypes* packed;
+    // The planes of the locus in the peek slot.
+    PackedGenotypes* nextPacked;
+
+    // If set, records are parsed ahead on a separate thread.
+    LocusPipeline* pipeline;
+
+    // The ids of the chromosomes. Only the thread parsing records adds to it.
+    ContigDictionary* contigs;
+    // The id of the chromosome of the locus last returned by get_next_locus.
+    int contigId;
+
+    // If set, only the records in the regions are returned, region by region.
+    Region* regions;
+    int numRegions;
+    int currentRegion;
+    // Set once a record on the current region's chromosome was read.
+    bool isInRegionChromosome;
+    // The index of a BGZF file. Used to seek to each region.
+    VCFIndex* index;
 } VCFGenotypeParser;
 
 // Creates a VCFGenotypeParser.
 // Accepts:
 //  char* file_name -> The name of the file to read in.
+//  int numThreads -> The number of threads used to inflate BGZF blocks. If 0, blocks are inflated on read.
+//                      Uncompressed files are memory-mapped instead.
+//                      Genotype caches written by write_genotype_cache are also accepted.
 // Returns:
 //  The created parser or NULL if file does not exist.
-VCFGenotypeParser* init_vcf_genotype_parser(char* file_name);
+VCFGenotypeParser* init_vcf_genotype_parser(char* file_name, int numThreads);
+
+// Creates a VCFGenotypeParser over a subset of the samples. The other sample columns are
+//  skipped without being decoded, so num_samples, the genotype arrays, and any encoder sized
+//  from num_samples cover only the subset. Samples keep their order in the file.
+// Accepts:
+//  char* file_name -> The name of the file to read in.
+//  int numThreads -> The number of threads used to inflate BGZF blocks. See init_vcf_genotype_parser.
+//  char* samples -> Sample names separated by commas. If it starts with ^, the samples are excluded instead.
+//                      If NULL, all samples are parsed.
+// Returns:
+//  The created parser or NULL if file does not exist, a sample is not in the file, or no samples are left.
+VCFGenotypeParser* init_vcf_genotype_parser_with_samples(char* file_name, int numThreads, char* samples);
+
+// Packs the genotypes of biallelic loci into bitplanes as they are parsed.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+// Returns:
+//  void.
+void enable_genotype_packing(VCFGenotypeParser* parser);
+
+// Packs biallelic genotypes into bitplanes.
+// Accepts:
+//  GENOTYPE* genotypes -> The genotypes to pack.
+//  int numSamples -> The number of genotypes.
+//  PackedGenotypes* packed -> The planes to fill.
+// Returns:
+//  bool, False if an allele is not 0, 1, or missing (2).
+bool pack_genotypes(GENOTYPE* genotypes, int numSamples, PackedGenotypes* packed);
+
+// Sets the size of the buffer records are read through. Records longer than the buffer
+//  take more than one read. When a parser is created, the buffer is sized from the number
+//  of samples. Does nothing for mapped files and caches. Must be called before
+//  enable_locus_pipelining.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+//  int bufferSize -> The size of the buffer in bytes.
+// Returns:
+//  void.
+void set_stream_buffer_size(VCFGenotypeParser* parser, int bufferSize);
+
+// Parses records on a separate thread, so parsing overlaps with the consumer's work.
+//  Records are returned in the same order with the same values. Must be called after
+//  enable_genotype_packing and seek_vcf_genotype_parser, if either is used.
+//  Does nothing on a single core.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+// Returns:
+//  void.
+void enable_locus_pipelining(VCFGenotypeParser* parser);
+
+// Moves the parser forward to a record and restricts it to the records before an offset.
+//  Used to split a file into independent chromosome streams.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+//  long startOffset -> The uncompressed offset of the record to move to. Must not be before the next record.
+//  long endOffset -> The parser sets isEOF at the record with this offset. If -1, reads to EOF.
+// Returns:
+//  void.
+void seek_vcf_genotype_parser(VCFGenotypeParser* parser, long startOffset, long endOffset);
+
+// Logs where each BGZF block the parser reads starts, so tell_vcf_genotype_parser can give
+//  the virtual offset of the next record. Reads the file up to the parser's position again.
+//  Must be called before enable_locus_pipelining.
+//  Does nothing for mapped files, caches, and gzip files that are not BGZF.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+// Returns:
+//  void.
+void enable_checkpointing(VCFGenotypeParser* parser);
+
+// Gets the position of the next record, so a new parser can resume from it.
+//  Positions must be asked for in file order.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+//  long* offset -> Set to the uncompressed offset of the next record, or its index in a cache.
+//  unsigned long long* virtualOffset -> Set to the BGZF virtual offset of the next record,
+//                                          or 0 if checkpointing is not enabled.
+// Returns:
+//  bool, False if EOF, regions are set, or the record's block was not kept.
+bool tell_vcf_genotype_parser(VCFGenotypeParser* parser, long* offset, unsigned long long* virtualOffset);
+
+// Moves a new parser to a position given by tell_vcf_genotype_parser on the same file.
+//  A BGZF file seeks to the virtual offset. Otherwise, the lines before the record are skipped.
+//  Must be called before enable_locus_pipelining.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+//  long offset -> The uncompressed offset of the record.
+//  unsigned long long virtualOffset -> The virtual offset of the record, or 0 if unknown.
+// Returns:
+//  bool, False if the parser could not be moved.
+bool resume_vcf_genotype_parser(VCFGenotypeParser* parser, long offset, unsigned long long virtualOffset);
+
+// Restricts the parser to a list of regions. If the file is BGZF compressed and has a
+//  .csi or .tbi index, the parser seeks to each region. A genotype cache seeks with its
+//  chromosome dictionary. Otherwise, the file is scanned and the regions must be in file order.
+//  Regions on the same chromosome are read back to back, so windows may span the gap between them.
+//  Must be called before enable_locus_pipelining.
+// Accepts:
+//  VCFGenotypeParser* parser -> A pointer to a parser.
+//  char* regions -> Regions separated by commas or whitespace. Each is chr, chr:start, chr:start-, or chr:start-end.
+// Returns:
+//  bool, False if a region is malformed. The parser is left unchanged.
+bool set_vcf_regions(VCFGenotypeParser* parser, char* regions);
+
+// The records of a chromosome as uncompressed offsets into the VCF file.
+typedef struct {
+    // The name of the chromosome.
+    kstring_t* chromosome;
+    // The offset of the first record on the chromosome.
+    long startOffset;
+    // The offset after the last record on the chromosome, or -1 if at the end of the file.
+    long endOffset;
+} ChromosomeRange;
+
+// Pre-scans a VCF file for the range of each chromosome. Only the CHROM field is parsed.
+// Accepts:
+//  char* file_name -> The name of the file to scan.
+//  int numThreads -> The number of threads used to inflate BGZF blocks.
+//  int* numChromosomes -> Set to the number of chromosomes.
+// Returns:
+//  ChromosomeRange*, The ranges in file order, or NULL if the file does not exist.
+ChromosomeRange* scan_chromosome_ranges(char* file_name, int numThreads, int* numChromosomes);
 
 // Get the next record from a parser.
 // Accepts:
 //  VCFGenotypeParser* parser -> A pointer to a parser.
-//  kstring_t* chromosome -> Sets the chromosome of the record.
+//  kstring_t* chromosome -> Sets the chromosome of the record. If NULL, the name is not copied,
+//                              and the chromosome is identified by parser -> contigId.
 //  int* position -> Sets the position of the record.
 //  int* numOfAlleles -> Sets the number of alleles at that locus.
 //  GENOTYPE** genotypes -> Fills an array of samples' genotypes. Is set (swapped)
@@ -81,26 +379,65 @@ void get_next_locus(VCFGenotypeParser* parser, kstring_t* chromosome, int* posit
 //  void.
 void destroy_vcf_genotype_parser(VCFGenotypeParser* parser);
 
+// Character classes used when parsing genotypes.
+#define IS_DIGIT(c) ((unsigned char) ((c) - '0') < 10)
+#define IS_SEPARATOR(c) ((c) == '|' || (c) == '/')
+// The characters that may follow a genotype. Files may end lines with "\r\n".
+#define IS_GENOTYPE_END(c) ((c) == '\t' || (c) == ':' || (c) == '\n' || (c) == '\r' || (c) == '\0')
+
+// Parses an allele of a genotype.
+// Accepts:
+//  char** start -> The start of the allele. Set to the character after the allele.
+//  int numAlleles -> The number of possible alleles at the record.
+//  bool* isMalformed -> Set if the allele is not a number or '.', or is not below numAlleles.
+// Returns:
+//  int, The allele, or numAlleles if it is missing or malformed.
+static inline int parse_allele(char** start, int numAlleles, bool* isMalformed) {
+    char* c = *start;
+    if (*c == '.') {
+        *start = c + 1;
+        return numAlleles;
+    }
+    // Stop adding digits once the allele is out of range, so it cannot overflow.
+    int allele = 0;
+    for (; IS_DIGIT(*c) && allele < numAlleles; c++)
+        allele = 10 * allele + (*c - '0');
+    bool isValid = c > *start && allele < numAlleles && !IS_DIGIT(*c);
+    for (; IS_DIGIT(*c); c++);
+    *start = c;
+    if (!isValid) {
+        *isMalformed = true;
+        return numAlleles;
+    }
+    return allele;
+}
+
 // Encodes the genotype of a sample into a byte.
 //  The function that is called the most. Is it fast enough?
+//  A genotype with one allele has a missing right allele.
 // Accepts:
 //  char* start -> A pointer to the beginning of a genotype in a VCF record.
 //  int numAlleles -> The number of possible alleles at the record.
+//  bool* isMalformed -> Set if an allele is malformed or the genotype does not end after two alleles.
 // Returns:
 //  GENOTYPE, The encoded genotype of the sample. 
-static inline GENOTYPE parse_genotype(char* start, int numAlleles) {
+static inline GENOTYPE parse_genotype(char* start, int numAlleles, bool* isMalformed) {
+    // Most genotypes have single digit alleles, so skip the general parse. Out of range alleles take
+    //  the general parse, which marks them malformed.
+    if (IS_DIGIT(start[0]) && IS_SEPARATOR(start[1]) && IS_DIGIT(start[2]) && IS_GENOTYPE_END(start[3])
+            && start[0] - '0' < numAlleles && start[2] - '0' < numAlleles)
+        return (GENOTYPE) (((start[0] - '0') << 4) | (start[2] - '0'));
     // There are numAlleles at the locus labeled 0 ... numAlleles - 1.
-    //  The numAllele denotes the missing allele. Set initial genotype to
-    //  two missing alleles.
-    GENOTYPE genotype = (GENOTYPE) (numAlleles << 4) | numAlleles;
-    char* next = start + 1;
-    // If the left allele is not missing, then parse integer and set left genotype.
-    if (start[0] != '.')
-        genotype = (strtol(start, &next, 10) << 4) | numAlleles;
-    // If there is a second, non-missing genotype, parse and set right genotype.
-    if ((next[0] == '|' || next[0] == '/') && next[1] != '.')
-        genotype = (genotype & 0xF0) | strtol(next + 1, (char**) NULL, 10);
-    return genotype;
+    //  The numAllele denotes the missing allele.
+    char* next = start;
+    int left = parse_allele(&next, numAlleles, isMalformed), right = numAlleles;
+    if (IS_SEPARATOR(*next)) {
+        next++;
+        right = parse_allele(&next, numAlleles, isMalformed);
+    }
+    if (!IS_GENOTYPE_END(*next))
+        *isMalformed = true;
+    return (GENOTYPE) ((left << 4) | right);
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,268 @@
+// File: VCFIndex.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Reads tabix and CSI indices to find the BGZF offsets of a region of a VCF file.
+
+#include <string.h>
+
+#include "VCFIndex.h"
+
+#include "BGZFReader.h"
+
+// Reads bytes from the inflated index. Indices are little-endian.
+typedef struct {
+    unsigned char* data;
+    size_t length;
+    size_t offset;
+    // Set if a read went past the end of the index.
+    bool isTruncated;
+} IndexCursor;
+
+// Reads a little-endian integer.
+// Accepts:
+//  IndexCursor* cursor -> The cursor.
+//  int numBytes -> The size of the integer.
+// Returns:
+//  unsigned long long, The integer, or 0 if the index is truncated.
+static unsigned long long read_bytes(IndexCursor* cursor, int numBytes) {
+    if (cursor -> offset + numBytes > cursor -> length) {
+        cursor -> isTruncated = true;
+        cursor -> offset = cursor -> length;
+        return 0;
+    }
+    unsigned long long value = 0;
+    for (int i = 0; i < numBytes; i++)
+        value |= (unsigned long long) cursor -> data[cursor -> offset + i] << (8 * i);
+    cursor -> offset += numBytes;
+    return value;
+}
+
+#define read_int32(cursor) ((int) read_bytes(cursor, 4))
+#define read_uint32(cursor) ((unsigned int) read_bytes(cursor, 4))
+#define read_uint64(cursor) (read_bytes(cursor, 8))
+
+// Inflates a whole BGZF file into memory.
+// Accepts:
+//  char* file_name -> The file to read.
+//  size_t* length -> Set to the number of inflated bytes.
+// Returns:
+//  unsigned char*, The inflated bytes, or NULL if the file does not exist or is malformed.
+static unsigned char* inflate_file(char* file_name, size_t* length) {
+    BGZFReader* reader = init_bgzf_reader(file_name, 0);
+    if (reader == NULL)
+        return NULL;
+    size_t capacity = 1 << 16;
+    unsigned char* data = (unsigned char*) malloc(capacity);
+    *length = 0;
+    int numRead;
+    while ((numRead = bgzf_read(reader, data + *length, capacity - *length)) > 0) {
+        *length += numRead;
+        if (*length == capacity) {
+            capacity *= 2;
+            data = (unsigned char*) realloc(data, capacity);
+        }
+    }
+    destroy_bgzf_reader(reader);
+    if (numRead < 0) {
+        free(data);
+        return NULL;
+    }
+    return data;
+}
+
+// Reads the bins of each reference.
+// Accepts:
+//  IndexCursor* cursor -> Points to the first reference.
+//  VCFIndex* index -> The index with numReferences set.
+//  bool isCSI -> If set, bins carry a loffset and there is no linear index.
+// Returns:
+//  void.
+static void read_references(IndexCursor* cursor, VCFIndex* index, bool isCSI) {
+    for (int i = 0; i < index -> numReferences && !(cursor -> isTruncated); i++) {
+        IndexReference* reference = &(index -> references[i]);
+        int numBins = read_int32(cursor);
+        if (numBins < 0 || numBins > cursor -> length) {
+            cursor -> isTruncated = true;
+            return;
+        }
+        reference -> numBins = numBins;
+        reference -> bins = (IndexBin*) calloc(numBins > 0 ? numBins : 1, sizeof(IndexBin));
+        for (int j = 0; j < reference -> numBins && !(cursor -> isTruncated); j++) {
+            IndexBin* bin = &(reference -> bins[j]);
+            bin -> bin = read_uint32(cursor);
+            if (isCSI)
+                read_uint64(cursor);
+            bin -> numChunks = read_int32(cursor);
+            if (bin -> numChunks < 0 || bin -> numChunks > cursor -> length) {
+                cursor -> isTruncated = true;
+                return;
+            }
+            bin -> chunks = (IndexChunk*) calloc(bin -> numChunks > 0 ? bin -> numChunks : 1, sizeof(IndexChunk));
+            for (int k = 0; k < bin -> numChunks; k++) {
+                bin -> chunks[k].begin = read_uint64(cursor);
+                bin -> chunks[k].end = read_uint64(cursor);
+            }
+        }
+        if (isCSI)
+            continue;
+        reference -> numIntervals = read_int32(cursor);
+        if (reference -> numIntervals < 0 || reference -> numIntervals > cursor -> length) {
+            cursor -> isTruncated = true;
+            return;
+        }
+        reference -> intervals = (unsigned long long*) calloc(reference -> numIntervals > 0 ? reference -> numIntervals : 1, sizeof(unsigned long long));
+        for (int j = 0; j < reference -> numIntervals; j++)
+            reference -> intervals[j] = read_uint64(cursor);
+    }
+}
+
+// Reads the tabix header that names the references. In a CSI file, it is the auxiliary data.
+// Accepts:
+//  IndexCursor* cursor -> Points to the format field of the header.
+//  VCFIndex* index -> The index. The references are allocated and named.
+//  int numReferences -> The number of references.
+// Returns:
+//  void.
+static void read_reference_names(IndexCursor* cursor, VCFIndex* index, int numReferences) {
+    // Skip format, col_seq, col_beg, col_end, meta, and skip.
+    cursor -> offset += 6 * 4;
+    int namesLength = read_int32(cursor);
+    if (numReferences < 0 || namesLength < 0 || cursor -> offset + namesLength > cursor -> length) {
+        cursor -> isTruncated = true;
+        return;
+    }
+    index -> numReferences = numReferences;
+    index -> references = (IndexReference*) calloc(numReferences > 0 ? numReferences : 1, sizeof(IndexReference));
+    char* name = (char*) cursor -> data + cursor -> offset;
+    char* namesEnd = name + namesLength;
+    for (int i = 0; i < numReferences && name < namesEnd; i++) {
+        kputs(name, &(index -> references[i].name));
+        name += ks_len(&(index -> references[i].name)) + 1;
+    }
+    cursor -> offset += namesLength;
+}
+
+VCFIndex* load_vcf_index(char* vcf_file_name) {
+
+    kstring_t indexName = { 0, 0, NULL };
+    size_t length = 0;
+    unsigned char* data = NULL;
+    const char* extensions[2] = { ".csi", ".tbi" };
+    for (int i = 0; i < 2 && data == NULL; i++) {
+        indexName.l = 0;
+        kputs(vcf_file_name, &indexName);
+        kputs((char*) extensions[i], &indexName);
+        data = inflate_file(ks_str(&indexName), &length);
+    }
+    free(ks_str(&indexName));
+    if (data == NULL)
+        return NULL;
+
+    IndexCursor cursor = { data, length, 0, false };
+    VCFIndex* index = (VCFIndex*) calloc(1, sizeof(VCFIndex));
+
+    if (length >= 4 && memcmp(data, "TBI\1", 4) == 0) {
+        cursor.offset = 4;
+        int numReferences = read_int32(&cursor);
+        index -> minShift = TABIX_LINEAR_SHIFT;
+        index -> depth = 5;
+        read_reference_names(&cursor, index, numReferences);
+        if (!cursor.isTruncated)
+            read_references(&cursor, index, false);
+    } else if (length >= 4 && memcmp(data, "CSI\1", 4) == 0) {
+        cursor.offset = 4;
+        index -> minShift = read_int32(&cursor);
+        index -> depth = read_int32(&cursor);
+        int auxLength = read_int32(&cursor);
+        size_t auxEnd = cursor.offset + auxLength;
+        // The reference names are in the auxiliary data. Read the count after it, then the names.
+        if (auxLength < 7 * 4 || auxEnd + 4 > length) {
+            cursor.isTruncated = true;
+        } else {
+            size_t auxStart = cursor.offset;
+            cursor.offset = auxEnd;
+            int numReferences = read_int32(&cursor);
+            cursor.offset = auxStart;
+            read_reference_names(&cursor, index, numReferences);
+            cursor.offset = auxEnd + 4;
+            if (!cursor.isTruncated)
+                read_references(&cursor, index, true);
+        }
+    } else {
+        cursor.isTruncated = true;
+    }
+
+    free(data);
+    if (cursor.isTruncated || index -> minShift <= 0 || index -> depth <= 0) {
+        destroy_vcf_index(index);
+        return NULL;
+    }
+    return index;
+
+}
+
+bool query_vcf_index(VCFIndex* index, char* chromosome, int start, int end, unsigned long long* virtualOffset) {
+
+    IndexReference* reference = NULL;
+    for (int i = 0; i < index -> numReferences && reference == NULL; i++)
+        if (strcmp(ks_str(&(index -> references[i].name)), chromosome) == 0)
+            reference = &(index -> references[i]);
+    if (reference == NULL)
+        return false;
+
+    // Bins use 0-based, half-open intervals.
+    long long begin = start > 0 ? start - 1 : 0, stop = end;
+
+    // Chunks that end before the first record in begin's interval cannot hold the region.
+    unsigned long long minimumOffset = 0;
+    if (reference -> numIntervals > 0) {
+        long long interval = begin >> TABIX_LINEAR_SHIFT;
+        minimumOffset = reference -> intervals[interval < reference -> numIntervals ? interval : reference -> numIntervals - 1];
+    }
+
+    // Take the earliest chunk of a bin that overlaps the region.
+    bool isFound = false;
+    for (int i = 0; i < reference -> numBins; i++) {
+        unsigned int bin = reference -> bins[i].bin;
+        // Find the level of the bin. Level l starts at bin (8^l - 1) / 7.
+        int level = 0;
+        unsigned long long levelStart = 0;
+        while (level <= index -> depth && bin >= levelStart + (1ULL << (3 * level))) {
+            levelStart += 1ULL << (3 * level);
+            level++;
+        }
+        // Bins past the last level hold metadata.
+        if (level > index -> depth)
+            continue;
+        int shift = index -> minShift + 3 * (index -> depth - level);
+        long long binBegin = (long long) (bin - levelStart) << shift, binEnd = binBegin + (1LL << shift);
+        if (binEnd <= begin || binBegin >= stop)
+            continue;
+        for (int j = 0; j < reference -> bins[i].numChunks; j++) {
+            IndexChunk* chunk = &(reference -> bins[i].chunks[j]);
+            if (chunk -> end <= minimumOffset)
+                continue;
+            if (!isFound || chunk -> begin < *virtualOffset)
+                *virtualOffset = chunk -> begin;
+            isFound = true;
+        }
+    }
+
+    return isFound;
+
+}
+
+void destroy_vcf_index(VCFIndex* index) {
+    if (index == NULL)
+        return;
+    for (int i = 0; i < index -> numReferences; i++) {
+        IndexReference* reference = &(index -> references[i]);
+        free(ks_str(&(reference -> name)));
+        for (int j = 0; j < reference -> numBins; j++)
+            free(reference -> bins[j].chunks);
+        free(reference -> bins);
+        free(reference -> intervals);
+    }
+    free(index -> references);
+    free(index);
+}
@@ -0,0 +1,77 @@
+// File: VCFIndex.h
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Reads tabix and CSI indices to find the BGZF offsets of a region of a VCF file.
+
+#ifndef _VCF_INDEX_
+#define _VCF_INDEX_
+
+#include <stdlib.h>
+
+#include <stdbool.h>
+
+#include "../klib/kstring.h"
+
+// The linear index of a tabix index has an entry per 16kb.
+#define TABIX_LINEAR_SHIFT 14
+
+// A range of virtual offsets holding records in a bin.
+typedef struct {
+    unsigned long long begin;
+    unsigned long long end;
+} IndexChunk;
+
+// A bin of the binning scheme. Covers a range of positions on one level.
+typedef struct {
+    unsigned int bin;
+    int numChunks;
+    IndexChunk* chunks;
+} IndexBin;
+
+// The bins of a chromosome.
+typedef struct {
+    kstring_t name;
+    int numBins;
+    IndexBin* bins;
+    // The tabix linear index. The offset of the first record in each 16kb interval.
+    int numIntervals;
+    unsigned long long* intervals;
+} IndexReference;
+
+// A tabix or CSI index.
+typedef struct {
+    // The size of the smallest bin is 2^minShift.
+    int minShift;
+    // The number of levels below the root bin.
+    int depth;
+    int numReferences;
+    IndexReference* references;
+} VCFIndex;
+
+// Loads the index of a BGZF compressed VCF file. Tries <file>.csi, then <file>.tbi.
+// Accepts:
+//  char* vcf_file_name -> The name of the VCF file.
+// Returns:
+//  VCFIndex*, The index, or NULL if there is none or it is malformed.
+VCFIndex* load_vcf_index(char* vcf_file_name);
+
+// Finds the virtual offset to start reading a region at. Records before the region may
+//  follow the offset, but no record in the region comes before it.
+// Accepts:
+//  VCFIndex* index -> The index.
+//  char* chromosome -> The chromosome of the region.
+//  int start -> The first position of the region, 1-based.
+//  int end -> The last position of the region, 1-based and inclusive.
+//  unsigned long long* virtualOffset -> Set to the offset.
+// Returns:
+//  bool, False if the index has no records in the region.
+bool query_vcf_index(VCFIndex* index, char* chromosome, int start, int end, unsigned long long* virtualOffset);
+
+// Deallocate all the memory occupied by an index.
+// Accepts:
+//  VCFIndex* index -> The index to destroy.
+// Returns:
+//  void.
+void destroy_vcf_index(VCFIndex* index);
+
+#endif
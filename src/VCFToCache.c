@@ -0,0 +1,24 @@
+// File: VCFToCache.c
+// Date: 16 October 2026
+// Author: TQ Smith
+// Purpose: Converts a VCF file into a genotype cache once, so repeated scans skip parsing.
+
+#include "GenotypeCache.h"
+
+#include <stdio.h>
+
+int main(int argc, char* argv[]) {
+
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "Usage: %s <in.vcf[.gz]> <out.cache> [numThreads]\n", argv[0]);
+        return 1;
+    }
+
+    if (!write_genotype_cache(argv[1], argv[2], argc == 4 ? atoi(argv[3]) : 0)) {
+        fprintf(stderr, "Could not convert %s to %s.\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    return 0;
+
+}
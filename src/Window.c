@@ -10,6 +10,8 @@
 
 #include <stdlib.h>
 
+#include <string.h>
+
 Window* init_window() {
     // Allocate the structure.
     Window* window = (Window*) calloc(1, sizeof(Window));
@@ -23,14 +25,191 @@ Window* init_window() {
     return window;
 }
 
+void reset_window(Window* window) {
+    // Set default numbering.
+    window -> windowNum = 1;
+    window -> windowNumOnChromosome = 1;
+    window -> numLoci = 0;
+    window -> startLocus = 0;
+    window -> endLocus = 0;
+    window -> numDistinctHaplotypes = 0;
+    window -> numMissingHaplotypes = 0;
+    window -> haplotypeHomozygosity = 0;
+    // Keep the chromosome's memory. A pooled window's name belongs to the pool.
+    if (window -> pool == NULL)
+        window -> chromosome -> l = 0;
+}
+
+// Frees a pool and its windows.
+// Accepts:
+//  WindowPool* pool -> The pool to free.
+// Returns:
+//  void.
+static void free_window_pool(WindowPool* pool) {
+    for (int i = 0; i < pool -> numBlocks; i++)
+        free(pool -> blocks[i]);
+    free(pool -> blocks);
+    free(pool -> freeWindows);
+    for (int i = 0; i < pool -> numChromosomes; i++) {
+        free(ks_str(pool -> chromosomes[i])); free(pool -> chromosomes[i]);
+    }
+    free(pool -> chromosomes);
+    free(pool);
+}
+
 void destroy_window(Window* window) {
     // Cannot destroy a NULL window.
     if (window == NULL)
         return;
 
+    // Return a pooled window to its pool.
+    if (window -> pool != NULL) {
+        WindowPool* pool = window -> pool;
+        pool -> numLive--;
+        if (pool -> isReleased) {
+            // Nothing takes windows from a released pool, so they are not kept.
+            if (pool -> numLive == 0)
+                free_window_pool(pool);
+            return;
+        }
+        if (pool -> numFree == pool -> maxFree) {
+            pool -> maxFree = pool -> maxFree == 0 ? WINDOW_POOL_BLOCK_SIZE : 2 * pool -> maxFree;
+            pool -> freeWindows = (Window**) realloc(pool -> freeWindows, pool -> maxFree * sizeof(Window*));
+        }
+        pool -> freeWindows[pool -> numFree++] = window;
+        return;
+    }
+
     // Free the chromosome string.
     free(ks_str(window -> chromosome)); free(window -> chromosome);
 
     // Free the structure.
     free(window);
 }
+
+WindowPool* init_window_pool() {
+    return (WindowPool*) calloc(1, sizeof(WindowPool));
+}
+
+Window* take_window(WindowPool* pool) {
+    Window* window;
+    // Reuse a returned window before handing out a new one.
+    if (pool -> numFree > 0)
+        window = pool -> freeWindows[--(pool -> numFree)];
+    else {
+        // Allocate a new block when the last one is used up.
+        if (pool -> numBlocks == 0 || pool -> numUsedInBlock == WINDOW_POOL_BLOCK_SIZE) {
+            if (pool -> numBlocks == pool -> maxBlocks) {
+                pool -> maxBlocks = pool -> maxBlocks == 0 ? 16 : 2 * pool -> maxBlocks;
+                pool -> blocks = (Window**) realloc(pool -> blocks, pool -> maxBlocks * sizeof(Window*));
+            }
+            pool -> blocks[pool -> numBlocks++] = (Window*) malloc(WINDOW_POOL_BLOCK_SIZE * sizeof(Window));
+            pool -> numUsedInBlock = 0;
+        }
+        window = &(pool -> blocks[pool -> numBlocks - 1][pool -> numUsedInBlock++]);
+    }
+    // Set default numbering.
+    memset(window, 0, sizeof(Window));
+    window -> windowNum = 1;
+    window -> windowNumOnChromosome = 1;
+    window -> pool = pool;
+    pool -> numLive++;
+    return window;
+}
+
+kstring_t* intern_chromosome(WindowPool* pool, int contigId, char* chromosome) {
+    // Windows arrive in file order, so the name is almost always the last one interned.
+    if (pool -> numChromosomes > 0 && pool -> lastContigId == contigId)
+        return pool -> chromosomes[pool -> numChromosomes - 1];
+    pool -> lastContigId = contigId;
+    if (pool -> numChromosomes == pool -> maxChromosomes) {
+        pool -> maxChromosomes = pool -> maxChromosomes == 0 ? 16 : 2 * pool -> maxChromosomes;
+        pool -> chromosomes = (kstring_t**) realloc(pool -> chromosomes, pool -> maxChromosomes * sizeof(kstring_t*));
+    }
+    kstring_t* name = (kstring_t*) calloc(1, sizeof(kstring_t));
+    kputs(chromosome, name);
+    pool -> chromosomes[pool -> numChromosomes++] = name;
+    return name;
+}
+
+void release_window_pool(WindowPool* pool) {
+    if (pool == NULL)
+        return;
+    pool -> isReleased = true;
+    if (pool -> numLive == 0)
+        free_window_pool(pool);
+}
+
+WindowStatistics* init_window_statistics(int WINDOW_SIZE) {
+    WindowStatistics* statistics = (WindowStatistics*) calloc(1, sizeof(WindowStatistics));
+    statistics -> maxHaplotypes = WINDOW_SIZE > 0 ? WINDOW_SIZE : 1;
+    statistics -> haplotypes = (HaplotypeStatistics*) calloc(statistics -> maxHaplotypes, sizeof(HaplotypeStatistics));
+    return statistics;
+}
+
+void add_haplotype_statistics(WindowStatistics* statistics, unsigned int* leftHaplotype, unsigned int* rightHaplotype, int numSamples, int numLeaves, int numLoci) {
+
+    // Count the samples with each label.
+    if (statistics -> maxCounts < numLeaves) {
+        statistics -> maxCounts = numLeaves;
+        free(statistics -> counts);
+        statistics -> counts = (int*) malloc(numLeaves * sizeof(int));
+    }
+    memset(statistics -> counts, 0, numLeaves * sizeof(int));
+    for (int i = 0; i < numSamples; i++) {
+        statistics -> counts[leftHaplotype[i]]++;
+        statistics -> counts[rightHaplotype[i]]++;
+    }
+
+    // Labels are given in the order they are first seen, so every label but the missing one is used.
+    HaplotypeStatistics haplotype;
+    haplotype.numDistinct = numLeaves - 1;
+    haplotype.numMissing = statistics -> counts[numLeaves - 1];
+    haplotype.numCalled = 2 * numSamples - haplotype.numMissing;
+    haplotype.numLoci = numLoci;
+    haplotype.sumOfSquaredCounts = 0;
+    for (int i = 0; i < numLeaves - 1; i++)
+        haplotype.sumOfSquaredCounts += (unsigned long long) statistics -> counts[i] * statistics -> counts[i];
+
+    push_haplotype_statistics(statistics, &haplotype);
+
+}
+
+void push_haplotype_statistics(WindowStatistics* statistics, HaplotypeStatistics* haplotype) {
+    // A full ring only happens if the caller never removes. Drop the oldest haplotype.
+    if (statistics -> numHaplotypes == statistics -> maxHaplotypes)
+        remove_haplotype_statistics(statistics, 1);
+    statistics -> haplotypes[(statistics -> first + statistics -> numHaplotypes++) % statistics -> maxHaplotypes] = *haplotype;
+    statistics -> numDistinct += haplotype -> numDistinct;
+    statistics -> numMissing += haplotype -> numMissing;
+    statistics -> sumOfSquaredCounts += haplotype -> sumOfSquaredCounts;
+    statistics -> sumOfSquaredCalled += (unsigned long long) haplotype -> numCalled * haplotype -> numCalled;
+    statistics -> numLoci += haplotype -> numLoci;
+}
+
+void remove_haplotype_statistics(WindowStatistics* statistics, int numHaplotypes) {
+    for (int i = 0; i < numHaplotypes && statistics -> numHaplotypes > 0; i++) {
+        HaplotypeStatistics* haplotype = &(statistics -> haplotypes[statistics -> first]);
+        statistics -> numDistinct -= haplotype -> numDistinct;
+        statistics -> numMissing -= haplotype -> numMissing;
+        statistics -> sumOfSquaredCounts -= haplotype -> sumOfSquaredCounts;
+        statistics -> sumOfSquaredCalled -= (unsigned long long) haplotype -> numCalled * haplotype -> numCalled;
+        statistics -> numLoci -= haplotype -> numLoci;
+        statistics -> first = (statistics -> first + 1) % statistics -> maxHaplotypes;
+        statistics -> numHaplotypes--;
+    }
+}
+
+void set_window_statistics(WindowStatistics* statistics, Window* window) {
+    window -> numDistinctHaplotypes = statistics -> numDistinct;
+    window -> numMissingHaplotypes = statistics -> numMissing;
+    window -> haplotypeHomozygosity = statistics -> sumOfSquaredCalled > 0 ? (double) statistics -> sumOfSquaredCounts / statistics -> sumOfSquaredCalled : 0;
+}
+
+void destroy_window_statistics(WindowStatistics* statistics) {
+    if (statistics == NULL)
+        return;
+    free(statistics -> haplotypes);
+    free(statistics -> counts);
+    free(statistics);
+}
@@ -9,6 +9,14 @@
 
 #include "../klib/kstring.h"
 
+#include <stdbool.h>
+
+// Windows are taken from a pool in blocks of this many.
+#define WINDOW_POOL_BLOCK_SIZE 1024
+
+// A pool of windows. Defined below.
+typedef struct WindowPool WindowPool;
+
 // A structure to hold a window's information.
 //  Will change significantly given the application.
 typedef struct {
@@ -26,8 +34,80 @@ typedef struct {
     // The number of loci within the window.
     int numLoci;
 
+    // The statistics of the window's haplotypes. Each haplotype is counted once when it
+    //  enters the window and once when it leaves. See WindowStatistics.
+    // The number of distinct haplotypes, summed over the haplotypes in the window.
+    long numDistinctHaplotypes;
+    // The number of sample haplotypes with a missing genotype, summed over the haplotypes.
+    long numMissingHaplotypes;
+    // The probability two sample haplotypes without a missing genotype are the same,
+    //  pooled over the haplotypes in the window.
+    double haplotypeHomozygosity;
+
+    // The pool the window was taken from. If NULL, the window was allocated on its own.
+    //  A pooled window's chromosome is interned by the pool and must not be modified.
+    WindowPool* pool;
+
 } Window;
 
+// Hands out windows from blocks, so a window costs no allocation of its own.
+//  Windows on the same chromosome share one interned name.
+struct WindowPool {
+    // The blocks of windows.
+    Window** blocks;
+    int numBlocks;
+    int maxBlocks;
+    // The number of windows handed out from the last block.
+    int numUsedInBlock;
+    // Windows returned to the pool.
+    Window** freeWindows;
+    int numFree;
+    int maxFree;
+    // The interned chromosome names.
+    kstring_t** chromosomes;
+    int numChromosomes;
+    int maxChromosomes;
+    // The contig id of the last interned name.
+    int lastContigId;
+    // The number of windows taken and not yet destroyed.
+    int numLive;
+    // Set once the owner released the pool. The pool is freed with its last window.
+    bool isReleased;
+};
+
+// The statistics of a haplotype across the samples.
+typedef struct {
+    // The number of distinct haplotypes, excluding the missing haplotype.
+    int numDistinct;
+    // The number of sample haplotypes with a missing genotype.
+    int numMissing;
+    // The sum of the squared count of each distinct haplotype.
+    unsigned long long sumOfSquaredCounts;
+    // The number of sample haplotypes without a missing genotype.
+    int numCalled;
+    // The number of loci in the haplotype.
+    int numLoci;
+} HaplotypeStatistics;
+
+// The running statistics of the haplotypes in a window. Haplotypes enter at the end of
+//  the window and leave from the start, so overlapping windows do not count them again.
+typedef struct {
+    // A ring of the haplotypes in the window, oldest first.
+    HaplotypeStatistics* haplotypes;
+    int maxHaplotypes;
+    int first;
+    int numHaplotypes;
+    // The sums over the haplotypes in the ring.
+    long numDistinct;
+    long numMissing;
+    unsigned long long sumOfSquaredCounts;
+    unsigned long long sumOfSquaredCalled;
+    long numLoci;
+    // The number of samples with each label. Used to count a haplotype.
+    int* counts;
+    int maxCounts;
+} WindowStatistics;
+
 // Creates a window object.
 //  Will change with the given application.
 // Accepts:
@@ -36,7 +116,14 @@ typedef struct {
 //  Window*, A pointer to a new window structure.
 Window* init_window();
 
-// Deallocates the memory occupied by a window.
+// Resets a window to the state of a new window so it can be reused.
+// Accepts:
+//  Window* window -> The window to reset.
+// Returns:
+//  void.
+void reset_window(Window* window);
+
+// Deallocates the memory occupied by a window. A pooled window is returned to its pool.
 //  Will change with the given application.
 // Accepts:
 //  Window* window -> The window to deallocate.
@@ -44,4 +131,87 @@ Window* init_window();
 //  void.
 void destroy_window(Window* window);
 
+// Creates a window pool.
+// Accepts:
+//  void.
+// Returns:
+//  WindowPool*, A pointer to a new pool.
+WindowPool* init_window_pool();
+
+// Takes a new window from a pool. Allocates only when a block is used up.
+// Accepts:
+//  WindowPool* pool -> The pool.
+// Returns:
+//  Window*, A window in the state of a new window. Its chromosome is NULL until set.
+Window* take_window(WindowPool* pool);
+
+// Finds the pool's copy of a chromosome name. Names are interned in the order they
+//  are seen, so only a change of chromosome copies the name.
+// Accepts:
+//  WindowPool* pool -> The pool.
+//  int contigId -> The id of the chromosome given by the parser.
+//  char* chromosome -> The name of the chromosome.
+// Returns:
+//  kstring_t*, The interned name. Lives as long as the pool.
+kstring_t* intern_chromosome(WindowPool* pool, int contigId, char* chromosome);
+
+// Creates an empty WindowStatistics.
+// Accepts:
+//  int WINDOW_SIZE -> The most haplotypes in a window.
+// Returns:
+//  WindowStatistics*, The created structure.
+WindowStatistics* init_window_statistics(int WINDOW_SIZE);
+
+// Counts a haplotype and adds it to the end of the window.
+// Accepts:
+//  WindowStatistics* statistics -> The statistics.
+//  unsigned int* leftHaplotype -> The first-seen label of each sample's left haplotype.
+//  unsigned int* rightHaplotype -> The first-seen label of each sample's right haplotype.
+//  int numSamples -> The number of samples.
+//  int numLeaves -> The number of labels. The last label is the missing haplotype.
+//  int numLoci -> The number of loci in the haplotype. A haplotype without loci is
+//                  added with no samples and one label.
+// Returns:
+//  void.
+void add_haplotype_statistics(WindowStatistics* statistics, unsigned int* leftHaplotype, unsigned int* rightHaplotype, int numSamples, int numLeaves, int numLoci);
+
+// Adds a counted haplotype to the end of the window. Used to restore a window's haplotypes.
+// Accepts:
+//  WindowStatistics* statistics -> The statistics.
+//  HaplotypeStatistics* haplotype -> The counts of the haplotype.
+// Returns:
+//  void.
+void push_haplotype_statistics(WindowStatistics* statistics, HaplotypeStatistics* haplotype);
+
+// Removes haplotypes from the start of the window.
+// Accepts:
+//  WindowStatistics* statistics -> The statistics.
+//  int numHaplotypes -> The number of haplotypes to remove. At most all of them.
+// Returns:
+//  void.
+void remove_haplotype_statistics(WindowStatistics* statistics, int numHaplotypes);
+
+// Sets a window's statistics from the haplotypes currently in the window.
+// Accepts:
+//  WindowStatistics* statistics -> The statistics.
+//  Window* window -> The window to set.
+// Returns:
+//  void.
+void set_window_statistics(WindowStatistics* statistics, Window* window);
+
+// Deallocates the memory occupied by a WindowStatistics.
+// Accepts:
+//  WindowStatistics* statistics -> The structure to deallocate.
+// Returns:
+//  void.
+void destroy_window_statistics(WindowStatistics* statistics);
+
+// Releases the owner's hold on a pool. The pool is freed once all of its windows
+//  are destroyed, so windows can outlive the code that created them.
+// Accepts:
+//  WindowPool* pool -> The pool to release.
+// Returns:
+//  void.
+void release_window_pool(WindowPool* pool);
+
 #endif
\ No newline at end of file